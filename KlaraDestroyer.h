@@ -1,3202 +1,4533 @@
-﻿
-#include <array>
-#include <string>
-#include <syncstream>
-#include <fstream>
-#include <random>
-#include <cassert>
-#include <unordered_map>
-#include <iostream>
-//#include <vector>
-#include <queue>
-#include <thread>
-#include <cfloat>
-#include <atomic>
-#include <mutex>
-#include <condition_variable>
-#include <functional>
-#include <sstream>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
-#include <barrier>
-#include <future>
-#include "stack_vector.h"
-#include "stack_string.h"
-
-//std::cout
-
-
-
-namespace KlaraDestroyer {
-std::ostream* outStream;
-#define out (*outStream)
-#define nl '\n'
-
-#define debugOut std::cerr
-//#ifdef _DEBUG std::cerr #else (void) #endif
-
-#ifdef _DEBUG
-#define AssertAssume(...)  assert(__VA_ARGS__)
-#else
-#if defined(_MSC_VER) && !defined(__clang__)
-#define AssertAssume(...)  __assume(__VA_ARGS__)
-#elif defined(__clang__)
-#define AssertAssume(...)  __builtin_assume(__VA_ARGS__)
-#else
-#define AssertAssume(...)  [[assume(__VA_ARGS__)]]
-#endif
-#endif
-
-
-
-//#define CASTLING_DISABLED
-#define RELAX_CASTLING_PREDICTIONS
-
-
-typedef int_fast8_t i8;
-typedef uint_fast8_t u8;
-typedef int_fast16_t i16;
-typedef uint_fast16_t u16;
-typedef int_fast32_t i32;
-typedef uint_fast32_t u32;
-typedef int_fast64_t i64;
-typedef uint_fast64_t u64;
-
-typedef std::chrono::duration<double, std::milli> duration_t;
-typedef stack_string<5> moveNotation;
-
-class GameState;
-
-static constexpr float kingPrice = 20000;
-static constexpr float matePrice = 10000000;
-
-static constexpr size_t maxMoves = 218;
-
-#define MOVE_PIECE_FREE_ONLY std::equal_to<float>()
-#define MOVE_PIECE_CAPTURE_ONLY std::greater<float>()
-#define MOVE_PIECE_FREE_CAPTURE std::greater_equal<float>()
-
-enum class PlayerSide : i8
-{
-    WHITE = 1,
-    BLACK = -1,
-    NONE = 0
-};
-
-enum class PieceGeneric : i8
-{
-    Nothing = 0,
-    Pawn = 1,//0x01,
-    Knight = 2,//0x02,
-    Bishop = 3,//0x03,
-    Rook = 4,//0x04,
-    Queen = 5,//0x05,
-    King = 6,//0x06,
-};
-
-enum class Piece : i8
-{
-    Nothing = 0,
-    PawnWhite = 1,//0x01,
-    KnightWhite = 2,//0x02,
-    BishopWhite = 3,//0x03,
-    RookWhite = 4,//0x04,
-    QueenWhite = 5,//0x05,
-    KingWhite = 6,//0x06,
-    PawnBlack = -1,//0x81,
-    KnightBlack = -2,//0x82,
-    BishopBlack = -3,//0x83,
-    RookBlack = -4,//0x84,
-    QueenBlack = -5,//0x85,
-    KingBlack = -6,//0x86
-};
-
-constexpr float operator * (float lhs, PlayerSide rhs) noexcept
-{
-    return lhs * static_cast<i8>(rhs);
-}
-constexpr double operator * (double lhs, PlayerSide rhs) noexcept
-{
-    return lhs * static_cast<i8>(rhs);
-}
-constexpr int8_t operator * (int8_t lhs, PlayerSide rhs) noexcept
-{
-    return lhs * static_cast<i8>(rhs);
-}
-constexpr int16_t operator * (int16_t lhs, PlayerSide rhs) noexcept
-{
-    return lhs * static_cast<i8>(rhs);
-}
-constexpr int32_t operator * (int32_t lhs, PlayerSide rhs) noexcept
-{
-    return lhs * static_cast<i8>(rhs);
-}
-constexpr int64_t operator * (int64_t lhs, PlayerSide rhs) noexcept
-{
-    return lhs * static_cast<i8>(rhs);
-}
-
-constexpr inline PlayerSide operator - (PlayerSide side) noexcept
-{
-    AssertAssume(static_cast<i8>(side) == 1 || static_cast<i8>(side) == -1);
-    return static_cast<PlayerSide>(-static_cast<i8>(side));
-}
-constexpr inline PlayerSide oppositeSide(PlayerSide side) noexcept
-{
-    return -side;
-}
-
-constexpr inline i8 index(PlayerSide side) noexcept
-{
-    AssertAssume(static_cast<i8>(side) == 1 || static_cast<i8>(side) == -1);
-    return (static_cast<i8>(side) + static_cast<i8>(1)) / static_cast<i8>(2);
-}
-
-constexpr inline i8 playerDirection(PlayerSide side) noexcept
-{
-    AssertAssume(static_cast<i8>(side) == 1 || static_cast<i8>(side) == -1);
-    return static_cast<i8>(side);
-}
-
-
-constexpr PlayerSide pieceColor(Piece p)
-{
-    return static_cast<PlayerSide>(((static_cast<int8_t>(p) & static_cast <int8_t>(0x80)) >> 6) | 0x01);
-}
-constexpr PieceGeneric toGenericPiece(Piece p)
-{
-    return (PieceGeneric)((static_cast<i8>(p) >= 0) ? static_cast<i8>(p) : -static_cast<i8>(p));
-    //return static_cast<PieceGeneric>(std::abs(p));
-}
-constexpr Piece operator * (Piece lhs, PlayerSide rhs) noexcept
-{
-    return static_cast<Piece>(static_cast<i8>(lhs) * static_cast<i8>(rhs));
-}
-constexpr Piece operator * (PieceGeneric lhs, PlayerSide rhs) noexcept
-{
-    return static_cast<Piece>(static_cast<i8>(lhs) * static_cast<i8>(rhs));
-}
-
-constexpr Piece fromGenericPiece(PieceGeneric p, PlayerSide side)
-{
-    return static_cast<Piece>(p * side);
-}
-constexpr inline Piece operator - (Piece piece) noexcept
-{
-    return static_cast<Piece>(-static_cast<i8>(piece));
-}
-
-
-static std::atomic<bool> criticalTimeDepleted;
-static std::atomic<bool> optimalTimeDepleted;
-static i8 fullDepth;
-static i8 availableMoves;
-static PlayerSide onMoveW;
-static bool shuffle;
-static std::chrono::steady_clock::time_point timeGlobalStarted;
-//static std::chrono::steady_clock::time_point timeDepthStarted;
-static std::atomic<float> alphaOrBeta;
-static constexpr i8 depthToStopOrderingPieces = 3;
-static constexpr i8 depthToStopOrderingMoves = 3;
-
-// Relax castling restrictions after certain depth. 0=full rules check only for next engines move, 1=also full check enemy move, 2=also full check engines second move, etc.
-// Set to at least 1 (to avoid obvious checkmate possibility)
-static constexpr i8 castlingMaxDepth = 2; 
-
-template<typename T>
-inline void update_max(std::atomic<T>& atom, const T& val)
-{
-    for (T atom_val = atom; atom_val < val && !atom.compare_exchange_weak(atom_val, val););//std::memory_order_relaxed
-}
-
-template<typename T>
-inline void update_min(std::atomic<T>& atom, const T& val)
-{
-    for (T atom_val = atom; atom_val > val && !atom.compare_exchange_weak(atom_val, val););//std::memory_order_relaxed
-}
-
-
-struct Options {
-    size_t MultiPV;
-    size_t Threads;
-    size_t Verbosity;
-    bool UCI_Chess960;
-};
-
-static Options options;
-static bool firstLevelPruning = true;
-
-
-constexpr i8 oneColumn = 1;
-constexpr inline i8 column(i8 indexOnBoard) noexcept
-{
-    return indexOnBoard % 8;
-}
-constexpr i8 oneRow = 8;
-constexpr inline i8 row(i8 indexOnBoard) noexcept
-{
-    return indexOnBoard / 8;
-}
-constexpr inline i8 toIndex(i8 column, i8 row) noexcept
-{
-    return row * oneRow + column * oneColumn;
-}
-
-
-template <typename T>
-class TempSwap
-{
-    T& toSwap;
-    T backup;
-public:
-    TempSwap(T& toSwap, T tempNewValue) : toSwap(toSwap), backup(toSwap)
-    {
-        toSwap = std::forward<T>(tempNewValue);
-    }
-    ~TempSwap()
-    {
-        toSwap = backup;
-    }
-};
-
-
-
-constexpr wchar_t symbolW(Piece p)
-{
-    switch (p)
-    {
-    case Piece::Nothing:
-        return L' ';
-    case Piece::PawnWhite:
-        return L'♙';
-    case Piece::KnightWhite:
-        return L'♘';
-    case Piece::BishopWhite:
-        return  L'♗';
-    case Piece::RookWhite:
-        return L'♖';
-    case Piece::QueenWhite:
-        return L'♕';
-    case Piece::KingWhite:
-        return L'♔';
-    case Piece::PawnBlack:
-        return L'♟';
-    case Piece::KnightBlack:
-        return L'♞';
-    case Piece::BishopBlack:
-        return L'♝';
-    case Piece::RookBlack:
-        return L'♜';
-    case Piece::QueenBlack:
-        return L'♛';
-    case Piece::KingBlack:
-        return L'♚';
-    default:
-        std::unreachable();
-    }
-}
-
-constexpr char symbolA(Piece p)
-{
-    switch (p)
-    {
-    case Piece::Nothing:
-        return ' ';
-    case Piece::PawnWhite:
-        return 'P';
-    case Piece::KnightWhite:
-        return 'N';
-    case Piece::BishopWhite:
-        return 'B';
-    case Piece::RookWhite:
-        return 'R';
-    case Piece::QueenWhite:
-        return 'Q';
-    case Piece::KingWhite:
-        return 'K';
-    case Piece::PawnBlack:
-        return 'p';
-    case Piece::KnightBlack:
-        return 'n';
-    case Piece::BishopBlack:
-        return 'b';
-    case Piece::RookBlack:
-        return 'r';
-    case Piece::QueenBlack:
-        return 'q';
-    case Piece::KingBlack:
-        return 'k';
-    default:
-        std::unreachable();
-    }
-}
-constexpr char symbolA(PieceGeneric p)
-{
-    switch (p)
-    {
-    case PieceGeneric::Nothing:
-        return ' ';
-    case PieceGeneric::Pawn:
-        return 'p';
-    case PieceGeneric::Knight:
-        return 'n';
-    case PieceGeneric::Bishop:
-        return 'b';
-    case PieceGeneric::Rook:
-        return 'r';
-    case PieceGeneric::Queen:
-        return 'q';
-    case PieceGeneric::King:
-        return 'k';
-    default:
-        std::unreachable();
-    }
-}
-
-constexpr Piece fromSymbol(char a)
-{
-    switch (a)
-    {
-    case ' ':
-        return Piece::Nothing;
-    case 'P':
-        return Piece::PawnWhite;
-    case 'N':
-        return Piece::KnightWhite;
-    case 'B':
-        return Piece::BishopWhite;
-    case 'R':
-        return Piece::RookWhite;
-    case 'Q':
-        return Piece::QueenWhite;
-    case 'K':
-        return Piece::KingWhite;
-    case 'p':
-        return Piece::PawnBlack;
-    case 'n':
-        return Piece::KnightBlack;
-    case 'b':
-        return Piece::BishopBlack;
-    case 'r':
-        return Piece::RookBlack;
-    case 'q':
-        return Piece::QueenBlack;
-    case 'k':
-        return Piece::KingBlack;
-    default:
-        std::unreachable();
-    }
-}
-
-constexpr PieceGeneric fromGenericSymbol(char a)
-{
-    switch (a)
-    {
-    case ' ':
-        return PieceGeneric::Nothing;
-    case 'p':
-        return PieceGeneric::Pawn;
-    case 'n':
-        return PieceGeneric::Knight;
-    case 'b':
-        return PieceGeneric::Bishop;
-    case 'r':
-        return PieceGeneric::Rook;
-    case 'q':
-        return PieceGeneric::Queen;
-    case 'k':
-        return PieceGeneric::King;
-    default:
-        std::unreachable();
-    }
-}
-
-const std::array<std::array<float, 64>, 7>* pestoPhase;
-const std::array<float, 7>* piecePhase;
-
-float priceAdjustment(PieceGeneric p, i8 pieceIndex)
-{
-    return (*pestoPhase)[(i8)p][pieceIndex];
-}
-//constexpr float priceAdjustment(Piece p, i8 column, i8 row)
-//{
-//    return priceAdjustment(toGenericPiece(p), column, row);
-//}
-float priceAdjustmentPov(Piece p, i8 column, i8 row)
-{
-    if (static_cast<i8>(p) < 0)//case(PlayerSide::BLACK):
-    {
-        return priceAdjustment((PieceGeneric)(-p), toIndex(column, row));
-    }
-    else//case(PlayerSide::WHITE):
-    {
-        return priceAdjustment((PieceGeneric)p, toIndex(column, 7 - row));
-    }
-}
-
-float pricePiece(PieceGeneric p)
-{
-    return (*piecePhase)[(i8)p];
-}
-
-float pricePiece(Piece p)
-{
-    return pricePiece(toGenericPiece(p));
-}
-
-float priceAbsolute(Piece p, i8 column, i8 row)
-{
-    auto res = pricePiece(p) + priceAdjustmentPov(p, column, row);
-    AssertAssume(res >= 0);
-    return res;
-}
-float priceRelative(Piece p, i8 column, i8 row)
-{
-    return priceAbsolute(p, column, row) * pieceColor(p);
-}
-
-std::ostream& printPiece(Piece p, std::ostream& os) {
-    return os << symbolA(p);
-}
-std::wostream& printPiece(Piece p, std::wostream& os) {
-    return os << symbolW(p);
-}
-
-constexpr i8 promoteRow(PlayerSide s) {
-    switch (s)
-    {
-    case PlayerSide::WHITE:
-        return 7;
-    case PlayerSide::BLACK:
-        return 0;
-    default:
-        std::unreachable();
-    }
-}
-
-constexpr i8 initialRow(Piece p) {
-    switch (p)
-    {
-    case Piece::PawnWhite:
-        return 1;
-    case Piece::KnightWhite:
-    case Piece::BishopWhite:
-    case Piece::RookWhite:
-    case Piece::QueenWhite:
-    case Piece::KingWhite:
-        return 0;
-    case Piece::PawnBlack:
-        return 6;
-    case Piece::KnightBlack:
-    case Piece::BishopBlack:
-    case Piece::RookBlack:
-    case Piece::QueenBlack:
-    case Piece::KingBlack:
-        return 7;
-    default:
-        std::unreachable();
-    }
-}
-
-constexpr std::array<Piece, 4> availablePromotes(Piece p)
-{
-    AssertAssume(toGenericPiece(p) == PieceGeneric::Pawn);
-
-    constexpr std::array<std::array<Piece, 4>, 2> evolveLastRow{ {{ Piece::QueenBlack, Piece::RookBlack, Piece::BishopBlack, Piece::KnightBlack } , { Piece::QueenWhite, Piece::RookWhite, Piece::BishopWhite, Piece::KnightWhite }} };
-
-    static_assert(index(PlayerSide::BLACK) == 0 && index(PlayerSide::WHITE) == 1); // We are assuming this in the array above
-
-    static_assert((i8)Piece::PawnWhite == 1 && (i8)Piece::PawnBlack == -1); // With the hack that we are doing in the next step, we need the pawns to be 1 and -1.
-
-    return evolveLastRow[index((PlayerSide)p)];
-}
-
-class GameState {
-    //Piece* board[64];
-public:
-    std::array<Piece, 64> board;
-    i32 repeatableMoves;
-    PlayerSide playerOnMove;
-    std::array<std::array<bool, 2>, 2> canCastle;
-
-    auto operator<=>(const GameState&) const noexcept = default;
-
-    GameState(const GameState& copy) noexcept = default;
-
-    GameState(GameState&& move) noexcept = default;
-
-    GameState& operator=(const GameState& copy) noexcept = default;
-
-    GameState& operator=(GameState&& move) noexcept = default;
-
-    GameState() : board{ Piece::Nothing }
-    {
-    }
-
-    constexpr GameState(std::array<Piece, 64> pieces, i32 repeatableMoves, PlayerSide playerOnMove, std::array<std::array<bool, 2>, 2> canCastle):board(pieces), repeatableMoves(repeatableMoves),playerOnMove(playerOnMove),canCastle(canCastle)
-    {}
-
-
-
-    constexpr std::array<char, 128> piecesCountA() const
-    {
-        std::array<char, 128> res { 0 };
-        for (const auto& i : board)
-        {
-            if (i != Piece::Nothing)
-                ++res[symbolA(i)];
-        }
-        return res;
-    }
-
-    float priceInLocation(i8 column, i8 row, PlayerSide playerColor) const
-    {
-        if (column < 0 || column > 7 || row < 0 || row > 7)
-            return -std::numeric_limits<float>::infinity();
-
-        auto piece = pieceAt(column,row);
-
-        AssertAssume(playerColor == PlayerSide::BLACK || playerColor == PlayerSide::WHITE);
-
-        if (piece == Piece::Nothing)
-            return 0;
-        else
-            return priceRelative(piece, column, row) * (-playerColor);
-    }
-
-    constexpr const Piece& pieceAt(i8 column, i8 row) const
-    {
-        AssertAssume (!(column < 0 || column > 7 || row < 0 || row > 7));
-        return board[column + (row * 8)];
-    }
-    constexpr Piece& pieceAt(i8 column, i8 row)
-    {
-        AssertAssume(!(column < 0 || column > 7 || row < 0 || row > 7));
-        return board[column + (row * 8)];
-    }
-
-    constexpr const Piece& pieceAt(char column, char row) const
-    {
-        if (column < 'a' || column>'h' || row < '1' || row>'8')
-            throw std::exception("Invalid coordinates");
-        else
-            return pieceAt((i8)(column - 'a'), (i8)(row - '1'));
-    }
-    constexpr Piece& pieceAt(char column, char row)
-    {
-        if (column < 'a' || column>'h' || row < '1' || row>'8')
-            throw std::exception("Invalid coordinates");
-        else
-            return pieceAt((i8)(column - 'a'), (i8)(row - '1'));
-    }
-
-    constexpr void movePiece(char columnFrom, char rowFrom, char columnTo, char rowTo)
-    {
-        auto& from = pieceAt(columnFrom, rowFrom);
-        auto& to = pieceAt(columnTo, rowTo);
-
-        if (from == Piece::Nothing)
-            debugOut << "ERROR! Moving an empty field!" << std::endl;
-            //throw std::exception("Trying to move an empty field");
-
-        to = from;
-        from = Piece::Nothing;
-    }
-
-    void print(PlayerSide pov = PlayerSide::WHITE) const
-    {
-        return print(out, pov);
-    }
-
-    template <class T>
-    void print(T& os, PlayerSide pov = PlayerSide::WHITE) const
-    {
-        static_assert(std::is_base_of<std::ios_base, T>::value, "Must be an output stream");
-        switch (pov)
-        {
-        case PlayerSide::BLACK:
-        {
-            for (i8 i = 0; i < 8; ++i) {
-                os << i + 1 << ' ';
-                for (i8 j = 7; j >= 0; --j) {
-                    os << '|';
-
-                    printPiece(board[j + i * 8], os);
-                }
-                os << '|' << nl;
-            }
-            os << "   h g f e d c b a";
-        } break;
-        case PlayerSide::WHITE:
-        {
-            for (i8 i = 7; i >= 0; --i) {
-                os << i + 1 << ' ';
-                for (i8 j = 0; j < 8; ++j) {
-                    os << '|';
-                    //wcout<<((((j+i*8)%2)==0)?"\033[40m":"\033[43m");
-                    printPiece(board[j + i * 8], os);
-                }
-                os << '|' << nl;
-            }
-            os << "   a b c d e f g h";
-        } break;
-        default:
-            std::unreachable();
-        }
-
-        os << nl << std::flush;
-    }
-
-
-    moveNotation findDiff(const GameState& old) const
-    {
-        std::array<char, 6> res = { 0 };
-
-        Piece oldPiece = Piece::Nothing;
-
-        for (size_t i = 0; i < board.size(); ++i)
-        {
-            if (board[i] == Piece::Nothing && old.board[i] != Piece::Nothing)
-            {
-                oldPiece = old.board[i];
-
-                res[0] = i % 8 + 'a';
-                res[1] = i / 8 + '1';
-
-                if(toGenericPiece(old.board[i]) == PieceGeneric::King)//castling hack
-                    break;
-            }
-        }
-        if (oldPiece == Piece::Nothing)
-            throw std::exception("No change made");
-        for (size_t i = 0; i < board.size(); ++i)
-        {
-            if (board[i] != Piece::Nothing && board[i] != old.board[i])
-            {
-                res[2] = i % 8 + 'a';
-                res[3] = i / 8 + '1';
-
-                if (toGenericPiece(oldPiece) == PieceGeneric::Pawn && (res[3] == '1' || res[3] == '8'))
-                {
-                    res[4] = tolower(symbolA(board[i]));
-                }
-
-                if (toGenericPiece(board[i]) == PieceGeneric::King)//castling hack
-                    break;
-            }
-        }
-        return moveNotation(res.data());
-    }
-    
-    float balance() const {
-        double res = 0;
-        for (i8 i = 0; i < 64; ++i) {
-            if (board[i] == Piece::Nothing) [[likely]]//Just optimization
-                continue;
-            if (toGenericPiece(board[i]) == PieceGeneric::King) [[unlikely]]//To avoid floating point overflow
-                continue;
-            res += priceRelative(board[i], i % 8, i / 8);
-        }
-        return res;
-    }
-
-    
-    constexpr i8 countPiecesMin() const
-    {
-        std::array<i8, 2> counters{ 0 };
-        for (const auto& i : board)
-        {
-            if (i != Piece::Nothing)
-                ++counters[index(pieceColor(i))];
-        }
-        return std::min(counters[0], counters[1]);
-    }
-
-    constexpr static GameState startingPosition()
-    {
-        return GameState(
-            {
-                Piece::RookWhite, Piece::KnightWhite, Piece::BishopWhite, Piece::QueenWhite, Piece::KingWhite, Piece::BishopWhite, Piece::KnightWhite, Piece::RookWhite,
-                Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite,
-                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
-                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
-                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
-                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
-                Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack,
-                Piece::RookBlack, Piece::KnightBlack, Piece::BishopBlack, Piece::QueenBlack, Piece::KingBlack, Piece::BishopBlack, Piece::KnightBlack, Piece::RookBlack
-            },
-            0,
-            PlayerSide::WHITE,
-            { { { true, true },
-            { true, true } } }
-        );
-    }
-};
-
-
-struct BoardHasher
-{
-    std::size_t operator()(const GameState& s) const noexcept
-    {
-        size_t* toHash = (size_t*)s.board.data();
-        constexpr size_t sizeToHash = 64 / sizeof(size_t);
-
-        size_t res = *toHash;
-        for (size_t i = 1; i < sizeToHash; ++i)
-        {
-            res ^= toHash[i];
-        }
-
-        return res;
-    }
-};
-
-static stack_vector<std::pair<GameState, float>, maxMoves> firstPositions;
-
-template <bool saveToVector = false>
-struct Variation {
-    size_t nodes = 0;
-
-    duration_t time = duration_t(0);
-    float bestFoundValue;
-    float startingValue;
-
-    GameState board;
-
-    bool pruned = false;
-
-    i8 variationDepth;
-
-    PlayerSide firstMoveOnMove;
-    moveNotation firstMoveNotation;
-
-    //std::unordered_map<GameState, float, BoardHasher> transpositions;
-
-
-    Variation() noexcept = default;
-    Variation(const Variation& copy) noexcept = default;//:researchedBoard(copy.researchedBoard),bestFoundValue(copy.bestFoundValue),pieceTakenValue(copy.pieceTakenValue){}
-    Variation(Variation&& toMove) noexcept = default;// :researchedBoard(move(toMove.researchedBoard)), bestFoundValue(toMove.bestFoundValue), pieceTakenValue(toMove.pieceTakenValue) {}
-
-
-    Variation& operator=(Variation&& toMove) noexcept = default;
-
-    Variation& operator=(const Variation& copy) noexcept = default;
-
-    friend bool operator<(const Variation& l, const Variation& r)
-    {
-        return l.bestFoundValue < r.bestFoundValue;
-    }
-    friend bool operator>(const Variation& l, const Variation& r)
-    {
-        return l.bestFoundValue > r.bestFoundValue;
-    }
-
-    //Variation(GameState researchedBoard, double bestFoundValue, double startingValue):researchedBoard(move(researchedBoard)),bestFoundValue(bestFoundValue), startingValue(startingValue) {}
-    //Variation(GameState board, float startingValue) :board(std::move(board)), bestFoundValue(startingValue), startingValue(startingValue) {}
-    Variation(GameState board, float bestFoundValue, float startingValue, i8 variationDepth, PlayerSide firstMoveOnMove, moveNotation firstMoveNotation) :board(std::move(board)), bestFoundValue(bestFoundValue), startingValue(startingValue), variationDepth(variationDepth), firstMoveOnMove(firstMoveOnMove), firstMoveNotation(firstMoveNotation){}
-
-
-
-
-    bool canTakeKing(PlayerSide onMove)
-    {
-        float alpha, beta;
-        alpha = -kingPrice;
-        beta = kingPrice;
-
-        TempSwap playerBackup(board.playerOnMove, onMove);
-        //TempSwap vectorBackup(saveToVector, false);
-
-        Variation<false>* thisHack = reinterpret_cast<Variation<false> *>(this);//TODO prasarna
-
-        TempSwap backupCastling(board.canCastle, { {{ false,false }, { false,false }} });
-
-        for (i8 i = 0; i < board.board.size(); ++i) {
-            Piece found = board.board[i];
-
-            if (found == Piece::Nothing)
-                continue;
-            if (pieceColor(found) == onMove)
-            {
-                auto foundVal = thisHack->bestMoveWithThisPieceScore((i % 8), (i / 8), 0, alpha, beta, 0);
-
-                if (foundVal * onMove == kingPrice) [[unlikely]]//Je možné vzít krále, hra skončila
-                    {
-                        return true;
-                    }
-
-            }
-        }
-        return false;
-    }
-
-    //bool canSquareBeTakenBy(i8 column, i8 row, PlayerSide attacker)
-    //{
-    //    i32 totalMoves = 0;
-    //    constexpr float valueSoFar = 0;
-    //    float alpha, beta;
-    //    alpha = -std::numeric_limits<float>::infinity();
-    //    beta = std::numeric_limits<float>::infinity();
-    //    const Piece* backup = pieceAt(column, row);
-    //    //if (backup == nullptr)
-    //    //    return false;
-    //    auto backupPlayer = playerOnMove;
-    //    playerOnMove = attacker;
-    //    
-    //    switch (attacker)
-    //    {
-    //    case WHITE:
-    //        pieceAt(column, row) = &baitBlack;
-    //        break;
-    //    case BLACK:
-    //        pieceAt(column, row) = &baitWhite;
-    //        break;
-    //    default:
-    //        std::unreachable();
-    //    }
-    //    
-    //    for (i8 i = 0; i < board.size(); ++i) {
-    //        const Piece* found = board[i];
-    //        if (found == nullptr)
-    //            continue;
-    //        if (found->pieceColor() == attacker)
-    //        {
-    //            auto foundVal = found->bestMoveWithThisPieceScore(*this, (i % 8), (i / 8), 1, alpha, beta, valueSoFar);
-    //            debugOut << foundVal << std::endl;
-    //            if (foundVal * attacker == baitWhite.pricePiece())//Bait taken
-    //            {
-    //                pieceAt(column, row) = backup;
-    //                playerOnMove = backupPlayer;
-    //                return true;
-    //            }
-    //        }
-    //    }
-    //    pieceAt(column, row) = backup;
-    //    playerOnMove = backupPlayer;
-    //    return false;
-    //}
-
-    bool canMove(PlayerSide onMove)
-    {
-        float alpha, beta;
-        alpha = -kingPrice;
-        beta = kingPrice;
-
-        for (i8 i = 0; i < board.board.size(); ++i) {
-            Piece found = board.board[i];
-
-            if (found == Piece::Nothing)
-                continue;
-            if (pieceColor(found) == onMove)
-            {
-                auto foundVal = bestMoveWithThisPieceScore((i % 8), (i / 8), 0, alpha, beta, 0);
-
-                if (foundVal != std::numeric_limits<float>::infinity() * (-1) * onMove)
-                    return true;
-            }
-        }
-        return false;
-    }
-
-    bool isValidSetup()
-    {
-        //TempSwap saveVectorBackup(saveToVector, false);
-        
-        //bool backup = saveToVector;
-        //saveToVector = false;
-        //Both kings must be on the researchedBoard exactly once
-        auto count = board.piecesCountA();
-        if (count['k'] != 1 || count['K'] != 1)
-            return false;
-
-        //print(debugOut);
-
-        //if (!canMove(opposideSide(playerOnMove)))
-          //  return false;
-        if (canTakeKing(board.playerOnMove))
-            return false;
-
-        //saveToVector = backup;
-
-        //TODO the rest
-        return true;
-    }
-    //double positionScoreHeuristic() {
-    //    double res = 0;
-    //    for (i8 i = 0; i < 64; ++i) {
-    //        if (board[i] != nullptr)
-    //        {
-    //            float alpha, beta;
-    //            alpha = -std::numeric_limits<float>::max();
-    //            beta = std::numeric_limits<float>::max();
-    //            i32 totalMoves = 0;
-    //            double totalValues = 0;
-    //            board[i]->bestMoveWithThisPieceScore(*this, (i % 8), (i / 8), 1, alpha, beta, totalMoves, totalValues, 0,true)
-    //            res += (((double)totalMoves)/2.0) * board[i]->pieceColor();
-    //            if(totalMoves>0)
-    //                res += std::min(std::max(totalValues,-100.0),100.0);
-    //        }
-    //    }
-    //    return res / 10000.0;
-    //}
-
-
-    //template <bool saveToVector>
-    float bestMoveScore(i8 depth, float valueSoFar, float alpha, float beta)
-    {
-        AssertAssume(board.playerOnMove == PlayerSide::WHITE || board.playerOnMove == PlayerSide::BLACK);
-
-        //if(depth>3)
-        //{
-        //    auto found = transpositions.find(*this);
-        //    if (found != transpositions.end())
-        //        return found->second;
-        //}
-
-        //{
-        //    debugOut << "Found it" << nl << std::flush;
-        //    print(debugOut);
-        //}
-
-
-        float bestValue = -std::numeric_limits<float>::infinity() * board.playerOnMove;
-
-        if (criticalTimeDepleted) [[unlikely]]
-            return bestValue;
-
-        if (depth > depthToStopOrderingPieces) [[unlikely]]
-        {
-            stack_vector<std::pair<float, i8>, 16> possiblePiecesToMove;
-
-            for (i8 i = 0; i < 64; ++i) {
-                float alphaTmp = alpha;
-                float betaTmp = beta;
-                const Piece found = board.board[i];
-
-                if (found == Piece::Nothing)
-                    continue;
-                if (pieceColor(found) == board.playerOnMove)
-                    possiblePiecesToMove.unchecked_emplace_back(bestMoveWithThisPieceScore(i % 8, i / 8, -1, alphaTmp, betaTmp, valueSoFar), i);
-            }
-
-            switch (board.playerOnMove)
-            {
-            case PlayerSide::WHITE: {
-                std::sort(possiblePiecesToMove.begin(), possiblePiecesToMove.end(), [](auto& left, auto& right) {return left.first > right.first; });
-            } break;
-            case PlayerSide::BLACK: {
-                std::sort(possiblePiecesToMove.begin(), possiblePiecesToMove.end(), [](auto& left, auto& right) {return left.first < right.first; });
-            } break;
-            default:
-                std::unreachable();
-            }
-
-            for (const auto& move : possiblePiecesToMove) {
-                i8 i = move.second;
-                const Piece found = board.board[i];
-                float foundVal;
-                if (depth > depthToStopOrderingMoves) [[unlikely]]
-                {
-                    foundVal = bestMoveWithThisPieceScoreOrdered((i % 8), (i / 8), depth - 1, alpha, beta, valueSoFar);
-                }
-                else
-                {
-                    foundVal = bestMoveWithThisPieceScore((i % 8), (i / 8), depth - 1, alpha, beta, valueSoFar);
-                }
-
-                //assert(variationDepth == depthW);
-
-                if (firstLevelPruning && depth == variationDepth) [[unlikely]]
-                {
-                    //std::osyncstream(debugOut) << "alpha: " << alpha << ", beta: " << beta << std::endl;
-                    switch (board.playerOnMove)
-                    {
-                    case PlayerSide::WHITE: {
-                        if (beta != alphaOrBeta)
-                        {
-                            beta = alphaOrBeta;
-                            pruned = true;
-                        }
-                    } break;
-                    case PlayerSide::BLACK: {
-                        if (alpha != alphaOrBeta)
-                        {
-                            alpha = alphaOrBeta;
-                            pruned = true;
-                        }
-                    } break;
-                    default:
-                        std::unreachable();
-                    }
-                    //std::osyncstream(debugOut) << "alpha: " << alpha << ", beta: " << beta << std::endl;
-                }
-
-
-                if (foundVal * board.playerOnMove > bestValue * board.playerOnMove)
-                {
-                    bestValue = foundVal;
-                }
-                if (foundVal * board.playerOnMove == kingPrice)//Je možné vzít krále, hra skončila
-                {
-                    //wcout << endl;
-                    //print();
-                    //break;
-                    return foundVal;//*depth;
-                }
-                if (beta <= alpha && bestValue != -std::numeric_limits<float>::infinity() * board.playerOnMove)
-                {
-                    break;
-                    //depthToPieces = 0;
-                }
-            }
-        }
-        else [[likely]]
-        {
-            for (i8 i = 0; i < 64; ++i) {
-                const Piece found = board.board[i];
-
-                if (found == Piece::Nothing)
-                    continue;
-                if (pieceColor(found) == board.playerOnMove)
-                {
-                    auto foundVal = bestMoveWithThisPieceScore((i % 8), (i / 8), depth - 1, alpha, beta, valueSoFar);
-
-                    if (foundVal * board.playerOnMove > bestValue * board.playerOnMove) {
-                        bestValue = foundVal;
-                    }
-                    if (foundVal * board.playerOnMove == kingPrice)//Je možné vzít krále, hra skončila
-                    {
-                        //wcout << endl;
-                        //print();
-                        //break;
-                        return foundVal;//*depth;
-                    }
-                    if (beta <= alpha && bestValue != -std::numeric_limits<float>::infinity() * board.playerOnMove)
-                    {
-                        break;
-                        //depthToPieces = 0;
-                    }
-                }
-            }
-        }
-
-        //if (saveToVector) [[unlikely]]
-            //return -std::numeric_limits<float>::max();
-
-
-        if (bestValue == (float)(std::numeric_limits<float>::infinity() * board.playerOnMove * (-1))) [[unlikely]]//Nemůžu udělat žádný legitimní tah (pat nebo mat)
-        {
-            //TempSwap saveToVectorBackup(saveToVector, false);
-
-            if (canTakeKing(oppositeSide(board.playerOnMove)))//if (round((bestMoveScore(1, onMove * (-1),valueSoFar, alpha, beta) * playerOnMove * (-1))/100) == kingPrice/100)//Soupeř je v situaci, kdy mi může vzít krále (ohrožuje ho)
-            {
-                bestValue = -matePrice * board.playerOnMove;//Dostanu mat, co nejnižší skóre
-            }
-            else
-            {//Dostal bych pat, ten je vždycky lepší než dostat mat, ale chci ho docílit jen když prohrávám
-                bestValue = 0;//When we return 0, stalemate is preffered only if losing (0 is better than negative)
-                //if (valueSoFar * playerOnMove > 0)
-                //{
-                //    //debugOut << "Stalemate not wanted for " << (unsigned)onMove << std::endl;
-                //    bestValue = -stalePrice * playerOnMove;//Vedu, nechci dostat pat
-                //}
-                //else
-                //{
-                //    //debugOut << "Stalemate wanted for "<< (unsigned)onMove << std::endl;
-                //    bestValue = stalePrice * playerOnMove;//Prohrávám, dostat pat beru jako super tah
-                //}  
-            }
-            bestValue *= depth;//To get shit done quickly
-        }
-
-        //if (depth > 3)
-        //    transpositions.emplace(*this, bestValue);
-        return bestValue;
-    }
-
-
-    auto tryPiece(i8 column, i8 row, Piece p, i8 depth, float alpha, float beta, float valueSoFar)
-    {
-        TempSwap pieceBackup(board.pieceAt(column, row), p);
-        board.playerOnMove = oppositeSide(board.playerOnMove);
-        auto tmp = bestMoveScore(depth, valueSoFar, alpha, beta);
-        board.playerOnMove = oppositeSide(board.playerOnMove);
-        return tmp;
-    }
-
-    void placePieceAt(Piece p, i8 column, i8 row, i8 depth, float& alpha, float& beta, float& bestValue, float valueSoFar, float priceTaken)
-    {
-        ++nodes;
-        if constexpr (saveToVector)
-        {
-            if (depth == 0)
-            {
-                TempSwap backup(board.pieceAt(column, row), p);
-                board.playerOnMove = oppositeSide(board.playerOnMove);
-                if (isValidSetup())
-                {
-                    //float pieceTakenValue = valueSoFar + priceAbsolute * pieceColor();
-                    //board.print();
-                    float balance = board.balance();
-                    firstPositions.emplace_back(board, balance);
-                }
-                board.playerOnMove = oppositeSide(board.playerOnMove);
-                return;
-            }
-        }
-
-
-        //if (doNotContinue) [[unlikely]]
-        //    return;
-
-        if (priceTaken >= kingPrice - 128) [[unlikely]]//Possible to take king (probaly check?)
-        {
-            //doNotContinue = true;
-            bestValue = kingPrice * board.playerOnMove;
-            //totalMoves++;
-            //return;
-        }
-        else [[likely]]
-        {
-            float valueGained = priceTaken + priceAdjustmentPov(p, column, row); //We are entering new position with this piece
-
-            //assert(variationDepth == depthW);
-            const auto wholeMovesFromRoot = ((variationDepth - depth) / 2);//Kolikaty tah od initial pozice (od 0), ne pultah
-            valueGained *= (1 - (wholeMovesFromRoot * 0.0001));//10000.0);
-
-            valueSoFar += valueGained * board.playerOnMove;//Add our gained value to the score
-
-            float foundVal;
-            if (depth > 0)
-            {
-                foundVal = tryPiece(column, row, p, depth, alpha, beta, valueSoFar);
-
-                if ((foundVal * board.playerOnMove * (-1)) == kingPrice)//V dalším tahu bych přišel o krále, není to legitimní tah
-                    return;
-            }
-            else//leaf node of the search tree
-                foundVal = valueSoFar;
-
-            if (foundVal * board.playerOnMove > bestValue * board.playerOnMove)
-                bestValue = foundVal;
-        }
-
-        switch (board.playerOnMove)
-        {
-        case(PlayerSide::WHITE): {
-            alpha = std::max(alpha, bestValue);//bily maximalizuje hodnotu
-        } break;
-        case(PlayerSide::BLACK): {
-            beta = std::min(beta, bestValue);
-        } break;
-        default:
-            std::unreachable();
-        }
-
-        //doNotContinue |= (beta <= alpha);
-    }
-
-
-    template <typename F>
-    bool tryPlacingPieceAt(Piece p, i8 column, i8 row, i8 depth, float& alpha, float& beta, float& bestValue, float valueSoFar, F condition)
-    {
-        if (beta <= alpha && bestValue != -std::numeric_limits<float>::infinity() * board.playerOnMove)
-            return false;
-
-        float price = board.priceInLocation(column, row, board.playerOnMove);
-
-        if (condition(price, 0))
-        {
-            placePieceAt(p, column, row, depth, alpha, beta, bestValue, valueSoFar, price);
-            return price == 0;
-        }
-        else
-            return false;
-    }
-
-    auto tryPlacingPieceAt(Piece p, i8 column, i8 row, i8 depth, float& alpha, float& beta, float& bestValue, float valueSoFar)
-    {
-        return tryPlacingPieceAt(p, column, row, depth, alpha, beta, bestValue, valueSoFar, MOVE_PIECE_FREE_CAPTURE);
-    }
-
-    template <typename T>
-    bool addMoveToList(Piece p, i8 column, i8 row, float alpha, float beta, T& possibleMoves)
-    {
-        float bestValue = -std::numeric_limits<float>::infinity() * board.playerOnMove;
-        bool fieldWasFree = tryPlacingPieceAt(p, column, row, 0, alpha, beta, bestValue, 0);
-
-        if (bestValue != -std::numeric_limits<float>::infinity() * board.playerOnMove)
-            possibleMoves.unchecked_emplace_back(bestValue, std::make_pair(column, row));
-
-        return fieldWasFree;
-    }
-
-    template <i8 rookColumn, i8 newRookColumn>
-    void tryCastling(Piece p, i8 row, /*i8 kingColumn, i8 rookColumn, i8 newRookColumn,*/ bool& canICastleLeft, bool& canICastleRight, float& bestValue, i8 depth, float& alpha, float& beta, float valueSoFar)
-    {
-        AssertAssume(row == 0 || row == 7);
-
-        constexpr i8 kingColumn = 4;
-        constexpr i8 sign = rookColumn < kingColumn ? 1 : -1;
-        constexpr i8 newKingColumn = kingColumn - 2 * sign;
-        /*Castling is permitted only if
-          - neither the king nor the rook has previously moved;
-          - the squares between the king and the rook are vacant;
-          - the king does not leave, cross over, or finish on a square attacked by an enemy piece.
-        */
-
-        for (i8 i = rookColumn + sign; i != kingColumn; i += sign)
-        {
-            if (board.pieceAt(i, row) != Piece::Nothing) [[likely]]//The path is not vacant
-                return;
-        }
-
-        auto pieceInCorner = board.pieceAt(rookColumn, row);
-        if (toGenericPiece(pieceInCorner) != PieceGeneric::Rook)//The piece in the corner is not a rook or is vacant
-            return;
-
-        //assert(variationDepth == depthW);
-
-        if (variationDepth - depth <= castlingMaxDepth) [[unlikely]]//To optimize time, we do not check whether the path is attacked, unless the move is immediate. May produce bad predictions, but only for small number of cases.
-        {
-            for (i8 i = kingColumn; i != newKingColumn; i -= sign)//Do not check the last field (where the king should be placed), it will be checked later anyway
-            {
-                TempSwap fieldSwap(board.pieceAt(i, row), p);
-                if (canTakeKing(oppositeSide(pieceColor(p)))) [[unlikely]]//The path is attacked by enemy
-                {
-                    return;
-                }
-            }
-        }
-
-        //Now we can be sure we can do the castling
-        valueSoFar -= priceAdjustmentPov(pieceInCorner, rookColumn, row);//Remove the position score of the rook, it is leaving
-        valueSoFar += priceAdjustmentPov(pieceInCorner, newRookColumn, row);//Add the score of the rook on the next position
-
-        //Castling is not allowed from this point onwards
-        TempSwap castleLeftBackup(canICastleLeft, false);
-        TempSwap castleRightBackup(canICastleRight, false);
-
-        //Do the actual piece movement
-        TempSwap rookBackup(board.pieceAt(rookColumn, row), Piece::Nothing);
-        TempSwap newRookBackup(board.pieceAt(newRookColumn, row), pieceInCorner);
-        tryPlacingPieceAt(p, newKingColumn, row, depth - 1, alpha, beta, bestValue, valueSoFar);
-        //State will be restored when calling destructors
-    }
-
-    float bestMoveWithThisPieceScore(i8 column, i8 row, i8 depth, float& alpha, float& beta, float valueSoFar)
-    {
-        float bestValue = -std::numeric_limits<float>::infinity() * board.playerOnMove;
-
-        Piece p = board.pieceAt(column, row);
-        PieceGeneric piece = toGenericPiece(p);
-
-        AssertAssume(pieceColor(p) == board.playerOnMove);
-
-        board.pieceAt(column, row) = Piece::Nothing;
-        valueSoFar -= priceAdjustmentPov(p, column, row) * board.playerOnMove;//We are leaving our current position
-        //board.playerOnMove = oppositeSide(board.playerOnMove);
-
-        switch (piece)
-        {
-        case PieceGeneric::Nothing:
-            break;
-        case PieceGeneric::Pawn:
-        {
-            if (row + playerDirection(board.playerOnMove) == promoteRow(board.playerOnMove)) [[unlikely]]
-            {
-                const auto& availableOptions = availablePromotes(p);
-                for (const auto& evolveOption : availableOptions) {
-                    float valueDifferenceNextMove = (pricePiece(evolveOption) - pricePiece(piece)) * board.playerOnMove;//Increase in material when the pawn promotes
-                    float valueSoFarEvolved = valueSoFar + valueDifferenceNextMove;
-
-                    //Capture diagonally
-                    tryPlacingPieceAt(evolveOption, column - 1, row + playerDirection(board.playerOnMove), depth, alpha, beta, bestValue, valueSoFarEvolved, MOVE_PIECE_CAPTURE_ONLY);
-                    tryPlacingPieceAt(evolveOption, column + 1, row + playerDirection(board.playerOnMove), depth, alpha, beta, bestValue, valueSoFarEvolved, MOVE_PIECE_CAPTURE_ONLY);
-
-                    //Go forward
-                    tryPlacingPieceAt(evolveOption, column, row + playerDirection(board.playerOnMove), depth, alpha, beta, bestValue, valueSoFarEvolved, MOVE_PIECE_FREE_ONLY);
-                }
-            }
-            else [[likely]]
-            {
-                //Capture diagonally
-                tryPlacingPieceAt(p, column - 1, row + playerDirection(board.playerOnMove), depth, alpha, beta, bestValue, valueSoFar, MOVE_PIECE_CAPTURE_ONLY);
-                tryPlacingPieceAt(p, column + 1, row + playerDirection(board.playerOnMove), depth, alpha, beta, bestValue, valueSoFar, MOVE_PIECE_CAPTURE_ONLY);
-
-                //Go forward
-
-                //First, try two fields forward (if possible) since it is usually the better option
-                if (row == initialRow(p) && board.pieceAt(column, row + playerDirection(board.playerOnMove)) == Piece::Nothing)
-                    tryPlacingPieceAt(p, column, row + playerDirection(board.playerOnMove) * 2, depth, alpha, beta, bestValue, valueSoFar, MOVE_PIECE_FREE_ONLY);
-
-                //Try one field forward
-                tryPlacingPieceAt(p, column, row + playerDirection(board.playerOnMove), depth, alpha, beta, bestValue, valueSoFar, MOVE_PIECE_FREE_ONLY);
-            }
-
-        } break;
-        case PieceGeneric::Knight:
-        {
-            tryPlacingPieceAt(p, column + 1, row + 2, depth, alpha, beta, bestValue, valueSoFar);
-            tryPlacingPieceAt(p, column + 1, row - 2, depth, alpha, beta, bestValue, valueSoFar);
-            tryPlacingPieceAt(p, column + 2, row + 1, depth, alpha, beta, bestValue, valueSoFar);
-            tryPlacingPieceAt(p, column + 2, row - 1, depth, alpha, beta, bestValue, valueSoFar);
-            tryPlacingPieceAt(p, column - 1, row + 2, depth, alpha, beta, bestValue, valueSoFar);
-            tryPlacingPieceAt(p, column - 1, row - 2, depth, alpha, beta, bestValue, valueSoFar);
-            tryPlacingPieceAt(p, column - 2, row + 1, depth, alpha, beta, bestValue, valueSoFar);
-            tryPlacingPieceAt(p, column - 2, row - 1, depth, alpha, beta, bestValue, valueSoFar);
-
-        } break;
-        case PieceGeneric::Bishop:
-        {
-            for (i8 i = 1; tryPlacingPieceAt(p, column + i, row + i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column + i, row - i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column - i, row + i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column - i, row - i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-        } break;
-        case PieceGeneric::Rook:
-        {
-            std::optional<TempSwap<bool>> castleBackup;
-
-            assert(column <= 7 && column >= 0);
-
-            if (initialRow(p) == row && column % 7 == 0)
-                castleBackup.emplace(board.canCastle[column / 7][index(board.playerOnMove)], false);
-
-            for (i8 i = 1; tryPlacingPieceAt(p, column, row + i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column, row - i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column + i, row, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column - i, row, depth, alpha, beta, bestValue, valueSoFar); ++i);
-
-        } break;
-        case PieceGeneric::Queen:
-        {
-            for (i8 i = 1; tryPlacingPieceAt(p, column + i, row + i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column + i, row - i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column - i, row + i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column - i, row - i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-
-            for (i8 i = 1; tryPlacingPieceAt(p, column, row + i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column, row - i, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column + i, row, depth, alpha, beta, bestValue, valueSoFar); ++i);
-            for (i8 i = 1; tryPlacingPieceAt(p, column - i, row, depth, alpha, beta, bestValue, valueSoFar); ++i);
-
-        } break;
-        case PieceGeneric::King:
-        {
-            bool& canICastleLeft = board.canCastle[0][index(board.playerOnMove)];
-            bool& canICastleRight = board.canCastle[1][index(board.playerOnMove)];
-
-
-#ifndef CASTLING_DISABLED
-            if (canICastleLeft)//Neither has moved
-            {
-                AssertAssume(column == 4);//King has to be in initial position
-                AssertAssume(row == 0 || row == 7);
-                tryCastling<0, 3>(p, row, canICastleLeft, canICastleRight, bestValue, depth + 1, alpha, beta, valueSoFar);
-            }
-            if (canICastleRight)//Neither has moved
-            {
-                AssertAssume(column == 4);//King has to be in initial position
-                AssertAssume(row == 0 || row == 7);
-                tryCastling<7, 5>(p, row, canICastleLeft, canICastleRight, bestValue, depth + 1, alpha, beta, valueSoFar);
-            }
-#endif
-
-            //Classic king movement
-            {
-                TempSwap castleLeftBackup(canICastleLeft, false);
-                TempSwap castleRightBackup(canICastleRight, false);
-
-                tryPlacingPieceAt(p, column + 1, row + 1, depth, alpha, beta, bestValue, valueSoFar);
-                tryPlacingPieceAt(p, column + 1, row,     depth, alpha, beta, bestValue, valueSoFar);
-                tryPlacingPieceAt(p, column + 1, row - 1, depth, alpha, beta, bestValue, valueSoFar);
-                tryPlacingPieceAt(p, column - 1, row + 1, depth, alpha, beta, bestValue, valueSoFar);
-                tryPlacingPieceAt(p, column - 1, row,     depth, alpha, beta, bestValue, valueSoFar);
-                tryPlacingPieceAt(p, column - 1, row - 1, depth, alpha, beta, bestValue, valueSoFar);
-                tryPlacingPieceAt(p, column    , row + 1, depth, alpha, beta, bestValue, valueSoFar);
-                tryPlacingPieceAt(p, column    , row - 1, depth, alpha, beta, bestValue, valueSoFar);
-            }
-        } break;
-        default:
-            std::unreachable();
-        }
-
-        board.pieceAt(column, row) = p;
-
-        return bestValue;
-    }
-
-    //float bestMoveWithThisPieceScore(Piece p, GameState& board, i8 column, i8 row, i8 depth, float& alpha, float& beta, float valueSoFar, bool doNotContinue = false)
-    //{
-    //    return bestMoveWithThisPieceScore(toGenericPiece(p), board, column, row, depth, alpha, beta, valueSoFar, doNotContinue);
-    //}
-
-    float bestMoveWithThisPieceScoreOrdered(i8 column, i8 row, i8 depth, float& alpha, float& beta, float valueSoFar)
-    {
-        Piece p = board.pieceAt(column, row);
-
-        std::optional<TempSwap<bool>> castleBackup; // Castling backup (only if moving rooks/king)
-
-        stack_vector<std::pair<float, std::pair<i8, i8>>, 27> possibleMoves;
-
-        switch (toGenericPiece(p))
-        {
-        case PieceGeneric::Nothing:
-            break;
-        case PieceGeneric::Pawn:
-        {
-            // No need to order/sort pawn movement, there are very few options which can usually be ordered hard-coded.
-            return bestMoveWithThisPieceScore(column, row, depth, alpha, beta, valueSoFar);
-        } break;
-        case PieceGeneric::Knight:
-        {
-            addMoveToList(p, column + 1, row + 2, alpha, beta, possibleMoves);
-            addMoveToList(p, column + 1, row - 2, alpha, beta, possibleMoves);
-            addMoveToList(p, column + 2, row + 1, alpha, beta, possibleMoves);
-            addMoveToList(p, column + 2, row - 1, alpha, beta, possibleMoves);
-            addMoveToList(p, column - 1, row + 2, alpha, beta, possibleMoves);
-            addMoveToList(p, column - 1, row - 2, alpha, beta, possibleMoves);
-            addMoveToList(p, column - 2, row + 1, alpha, beta, possibleMoves);
-            addMoveToList(p, column - 2, row - 1, alpha, beta, possibleMoves);
-
-        } break;
-        case PieceGeneric::Bishop:
-        {
-            for (i8 i = 1; addMoveToList(p, column + i, row + i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column + i, row - i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column - i, row + i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column - i, row - i, alpha, beta, possibleMoves); ++i);
-        } break;
-        case PieceGeneric::Rook:
-        {
-            assert(column <= 7 && column >= 0);
-
-            // Back up castling if needed
-            if (initialRow(p) == row && column % 7 == 0)
-                castleBackup.emplace(board.canCastle[column / 7][index(board.playerOnMove)], false);
-
-            for (i8 i = 1; addMoveToList(p, column + i, row, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column - i, row, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column, row + i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column, row - i, alpha, beta, possibleMoves); ++i);
-
-            // Castling will be restored only after the actual tryout, not here
-        } break;
-        case PieceGeneric::Queen:
-        {
-            for (i8 i = 1; addMoveToList(p, column + i, row + i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column + i, row - i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column - i, row + i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column - i, row - i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column + i, row, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column - i, row, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column, row + i, alpha, beta, possibleMoves); ++i);
-            for (i8 i = 1; addMoveToList(p, column, row - i, alpha, beta, possibleMoves); ++i);
-        } break;
-        case PieceGeneric::King:
-        {
-            //TODO make this piece work
-            //Watch out for castling support!
-            return bestMoveWithThisPieceScore(column, row, depth, alpha, beta, valueSoFar);
-        } break;
-        default:
-            std::unreachable();
-        }
-
-        switch (board.playerOnMove)
-        {
-        case PlayerSide::WHITE: {
-            std::sort(possibleMoves.begin(), possibleMoves.end(), [](auto& left, auto& right) {return left.first > right.first; });
-        } break;
-        case PlayerSide::BLACK: {
-            std::sort(possibleMoves.begin(), possibleMoves.end(), [](auto& left, auto& right) {return left.first < right.first; });
-        } break;
-        default:
-            std::unreachable();
-        }
-
-        TempSwap pieceBackup(board.pieceAt(column, row), Piece::Nothing);
-        float bestValue = -std::numeric_limits<float>::infinity() * board.playerOnMove;
-
-        valueSoFar -= priceAdjustmentPov(p, column, row) * board.playerOnMove;//We are leaving our current position
-
-        for (const auto& i : possibleMoves)
-            tryPlacingPieceAt(p, i.second.first, i.second.second, depth, alpha, beta, bestValue, valueSoFar);
-
-        return bestValue;
-    }
-};
-
-
-
-
-
-//template <typename T>
-//void printGeneralInfo(T& o)
-//{
-//    o << "info depth "<<depthW+1<<" time "<<time
-//}
-template <typename T>
-T& printScore(T& o, float scoreCp, i8 depth, PlayerSide playerOnMove)
-{
-    o << "score ";
-    int mateFound = round(abs(scoreCp) / matePrice);
-    if (mateFound > 0)
-    {//(1 * board.playerOnMove) + 
-        int mateIn = ceil((depth - mateFound) / 2.0);
-        if ((scoreCp * playerOnMove) < 0)
-            mateIn *= -1;
-        o << "mate " << mateIn;
-        //break; //If mate is inevitable, it makes no sense to continue looking
-    }
-    else
-        o << "cp " << round(scoreCp * playerOnMove);
-    return o;
-}
-
-void printLowerBound(float currentLowerBound, i8 depth)
-{
-    out << "info depth " << (unsigned)fullDepth << ' ';
-    if (depth + 1 != fullDepth)
-        out << "seldepth " << (unsigned)depth + 1 << ' ';
-
-    printScore(out, currentLowerBound, depth + 1, oppositeSide(onMoveW));
-    out << ' ';
-    out << "lowerbound";
-    out << nl << std::flush;
-}
-
-//std::atomic<size_t> totalNodesDepth;
-size_t totalNodesAll;
-std::optional<duration_t> timeForTheFirst;
-
-auto evaluateGameMove(Variation<> localBoard)//, double alpha = -std::numeric_limits<float>::max(), double beta = std::numeric_limits<float>::max())
-{
-    if (localBoard.variationDepth > 0) [[likely]] //Not predetermined result - e.g. not a draw by repetition
-    {
-        if (round(abs(localBoard.bestFoundValue) / matePrice) > 0) [[unlikely]]
-        {
-            debugOut << "Encountered board with mate possibility." << std::endl;
-            localBoard.bestFoundValue += (matePrice * (localBoard.bestFoundValue>0?1:-1))*2;
-            localBoard.time = duration_t(0); //Known mate
-        }
-        else
-        {
-            auto timeStart = std::chrono::high_resolution_clock::now();
-            //Variation localBoard(board);
-
-            if (!firstLevelPruning)//If we want to know multiple good moves, we cannot prune using a/B at root level
-            {
-                localBoard.bestFoundValue = localBoard.bestMoveScore(localBoard.variationDepth, localBoard.startingValue, -kingPrice, kingPrice);
-            }
-            else
-            {
-                float localAlphaBeta = alphaOrBeta;
-                if (abs(localAlphaBeta) != kingPrice)
-                    localBoard.pruned = true;
-
-                switch (localBoard.board.playerOnMove)
-                {
-                case PlayerSide::BLACK: {
-                    localBoard.bestFoundValue = localBoard.bestMoveScore(localBoard.variationDepth, localBoard.startingValue, localAlphaBeta, kingPrice);
-                } break;
-                case PlayerSide::WHITE: {
-                    localBoard.bestFoundValue = localBoard.bestMoveScore(localBoard.variationDepth, localBoard.startingValue, -kingPrice, localAlphaBeta);
-                } break;
-                default:
-                    std::unreachable();
-                }
-            }
-
-            //board.nodes = localBoard.nodes;
-            localBoard.time = std::chrono::high_resolution_clock::now() - timeStart;
-        }
-    }
-    else
-        localBoard.time = duration_t(0); //Known draw by repetition
-
-    switch (localBoard.board.playerOnMove)
-    {
-    case PlayerSide::BLACK: {
-        update_max(alphaOrBeta, localBoard.bestFoundValue);
-    } break;
-    case PlayerSide::WHITE: {
-        update_min(alphaOrBeta, localBoard.bestFoundValue);
-    } break;
-    default:
-        std::unreachable();
-    }
-
-    //totalNodesDepth += localBoard.nodes;
-    return localBoard;
-}
-
-static Variation<>* bestMove;
-static stack_vector<Variation<>, maxMoves>* q;
-static std::atomic<size_t> qPos;
-
-void workerFromQ(size_t threadId)//, double alpha = -std::numeric_limits<float>::max(), double beta = std::numeric_limits<float>::max())
-{
-    while (true)
-    {
-        if (optimalTimeDepleted || criticalTimeDepleted) [[unlikely]]
-            break;
-        size_t localPos = qPos.fetch_add(1ull, std::memory_order_relaxed);
-        if (localPos >= q->size()) [[unlikely]]//Stopper
-        {
-            --qPos;
-            break;
-        }
-
-        auto& board = (*q)[localPos];
-        AssertAssume(board.board.playerOnMove == onMoveW);
-        if (options.Verbosity >= 3)//[[likely]]
-        {
-            std::osyncstream(out)
-                << "info "
-                << "currmove "
-                << board.firstMoveNotation << ' '
-                << "currmovenumber "
-                << (localPos + 1)
-                << nl << std::flush;
-        }
-        auto res = evaluateGameMove(board);//TODO maybe move possible
-
-        //size_t localSolvedPos = solvedPos.fetch_add(1ull, std::memory_order_relaxed);
-
-        if (!criticalTimeDepleted) [[likely]]
-        {
-            board = std::move(res);
-
-            static std::mutex m_solved;
-            std::unique_lock lk(m_solved);
-            //solvedMoves->push_back(std::move(res));
-
-            if (bestMove == nullptr || board.bestFoundValue * board.board.playerOnMove < (bestMove->bestFoundValue * board.board.playerOnMove))
-            {
-                board.pruned = false;
-                bestMove = &board;
-
-                if (options.Verbosity >= 4)
-                    printLowerBound(bestMove->bestFoundValue, board.variationDepth);
-            }
-        }
-        else
-        {
-            //board.time = std::numeric_limits<duration_t>::infinity();
-            //ALREADY DONE ^
-        }
-        //if (criticalTimeDepleted) [[unlikely]]
-        //    --qPos;
-    }
-}
-
-std::atomic<bool> workToDo = false;
-std::atomic<bool> threadRestartWanted = false;
-void on_completion() noexcept {
-    workToDo = false;
-}
-std::optional<std::barrier<void(*)() noexcept>> barrier;
-
-stack_vector<std::thread, maxMoves> threadWorkers;
-
-
-
-void threadWorker(size_t threadId)
-{
-    while (true)
-    {
-        //debugOut << "thread " << threadId<<" ready for more work" << std::endl;
-        workToDo.wait(false);//Wait until next work is ready
-        //debugOut << "thread " << threadId <<" notified" << std::endl;
-        if (threadRestartWanted) [[unlikely]]//For changing the amount of workers
-            break;
-        workerFromQ(threadId);//Do the actual work
-        //debugOut << "thread " << threadId << " arrived and waiting" << std::endl;
-        //Signal that this worker is done and wait until all of them are.
-        barrier->arrive_and_wait();
-    }
-}
-
-void threadRestart(size_t threadsNewCount)
-{
-    if (!threadWorkers.empty())
-    {
-        threadRestartWanted = true;
-        workToDo = true;
-        workToDo.notify_all();
-
-        for (auto& i : threadWorkers)
-            i.join();
-
-        threadWorkers.clear();
-    }
-
-    workToDo = false;
-    threadRestartWanted = false;
-
-    barrier.emplace(threadsNewCount, on_completion);
-
-    for (size_t i = 1; i < threadsNewCount; ++i)
-        threadWorkers.emplace_back(threadWorker, i);
-}
-
-bool cutoffBadMoves(stack_vector<Variation<>,maxMoves>& boards, float cutoffPointRelative)
-{
-    float bestMoveScore = -boards[0].bestFoundValue * boards[0].firstMoveOnMove;
-
-    float cutoffPoint = bestMoveScore - cutoffPointRelative;
-
-    stack_vector<Variation<>, maxMoves> newBoards;
-
-    size_t cutoffCounter = 0;
-
-    for (size_t i = 1; i < boards.size(); ++i)
-    {
-        if ((-boards[i].bestFoundValue * boards[0].firstMoveOnMove) >= cutoffPoint)
-            newBoards.unchecked_push_back(std::move(boards[i]));
-        else
-            ++cutoffCounter;
-    }
-
-    debugOut << "Cutting off " << cutoffCounter << " bad moves to save time" << std::endl;
-
-    return cutoffCounter != 0;
-}
-
-
-
-
-void printMoveInfo(unsigned depth, const duration_t& elapsedTotal, const duration_t& elapsedDepth, const size_t& nodesDepth, const Variation<>& move, size_t moveRank, PlayerSide pov)
-{
-    const auto secondsPassed = std::chrono::duration_cast<std::chrono::duration<double>>(elapsedDepth);
-    out
-        << "info "
-        << "depth " << (unsigned)fullDepth << ' ';
-    if (depth != fullDepth) [[unlikely]]
-        out << "seldepth " << depth << ' ';
-    out
-        << "time "  << (size_t)round(elapsedTotal.count()) << ' '
-        << "nodes " << totalNodesAll << ' '
-        << "nps " << (size_t)round(nodesDepth / secondsPassed.count())<< ' '
-        ;
-    printScore(out, move.bestFoundValue, depth, pov) << ' ';
-    if (move.pruned)
-        out << "upperbound ";
-    out
-        << "multipv " << moveRank << ' '
-        << "pv " << move.firstMoveNotation
-        << nl;
-}
-
-static auto rd = std::random_device{};
-static auto rng = std::default_random_engine{ rd() };
-
-stack_vector<Variation<>,maxMoves> generateMoves(const GameState& board, PlayerSide bestForWhichSide, const stack_vector<std::array<Piece, 64>, 75>& playedPositions)//, i8 depth = 1
-{
-    alphaOrBeta = kingPrice * board.playerOnMove;
-    const i8 depth = 1;
-    criticalTimeDepleted = false;
-    onMoveW = board.playerOnMove;
-    fullDepth = 1;
-    //depthW = 1;
-    //totalNodesDepth = 0;
-    totalNodesAll = 0;
-    //saveToVector = true;
-
-    if (options.Verbosity >= 2)
-        out << "info depth 1" << nl << std::flush;
-    //transpositions.clear();
-    Variation<true> tmp(board, 0, 0, 1, board.playerOnMove, "");
-    //tmp.saveToVector = true;
-
-    firstPositions.clear();
-    tmp.bestMoveScore(1, 0, -std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-    //totalNodesDepth = tmp.nodes;
-    totalNodesAll = tmp.nodes;
-    //transpositions.clear();
-    stack_vector<Variation<>,maxMoves> res;// = std::move(firstPositions);
-    //res.reserve(firstPositions.size());
-
-    //Add move names
-    for (auto& pos : firstPositions)
-    {
-        if (std::find(playedPositions.begin(), playedPositions.end(), pos.first.board) != playedPositions.end()) [[unlikely]]
-        {
-            res.unchecked_emplace_back(pos.first, 0, 0, 0, pos.first.playerOnMove, pos.first.findDiff(board));
-            debugOut << "Deja vu! Found a possible move that results in an already played position: " << res.back().firstMoveNotation <<". Assigning a value of a draw." << std::endl;
-        }
-        else [[likely]]
-            res.unchecked_emplace_back(pos.first, pos.second, pos.second, depth, pos.first.playerOnMove, pos.first.findDiff(board));
-        //pos.startingValue *= bestForWhichSide;//To our POV
-        //pos.bestFoundValue *= bestForWhichSide;//To our POV
-        //pos.firstMoveNotation = pos.board.findDiff(board);
-        //pos.variationDepth = depth;
-        //pos.firstMoveOnMove = pos.board.playerOnMove;
-        //pos.movePosition = pos.researchedBoard;
-    }
-    //firstPositions.clear();
-    //if (depth > 1)
-    //{
-    //    auto firstMoves = std::move(res);
-    //    res.clear();
-
-    //    onMoveW = oppositeSide(board.playerOnMove);
-    //    depthW = depth - 1;
-
-
-    //    size_t i = 0;
-    //    for (auto& pos : firstMoves)
-    //    {
-    //        pos.researchedBoard.bestMoveScore(depth - 1, pos.startingValue, -std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-    //        for (; i < firstPositions.size(); ++i)
-    //        {
-    //            auto& move = firstPositions[i];
-    //            move.firstMoveNotation = pos.firstMoveNotation;
-    //            move.variationDepth = pos.variationDepth;
-    //            move.firstMoveOnMove = pos.firstMoveOnMove;
-    //            //move.startingValue = pos.startingValue;
-    //            //move.movePosition = pos.movePosition;
-    //        }
-    //    }
-
-    //    res = std::move(firstPositions);
-    //    firstPositions.clear();
-    //}
-
-    //saveToVector = false;
-
-    if (shuffle)
-    {
-        std::shuffle(res.begin(), res.end(), rng);
-    }
-
-    switch (bestForWhichSide)
-    {
-    case PlayerSide::WHITE: {
-        std::sort(res.begin(), res.end(), std::greater<Variation<>>());
-    } break;
-    case PlayerSide::BLACK: {
-        std::sort(res.begin(), res.end(), std::less<Variation<>>());
-    } break;
-    default:
-        std::unreachable();
-    }
-
-    duration_t elapsedTotal = std::chrono::high_resolution_clock::now() - timeGlobalStarted;
-
-    if (options.Verbosity >= 5)
-    {
-        for (size_t i = res.size() - 1; i != 0; --i)
-            printMoveInfo(depth, elapsedTotal, elapsedTotal, tmp.nodes, res[i], i + 1, bestForWhichSide);
-    }
-    if (options.Verbosity >= 1)
-    {
-        printMoveInfo(depth, elapsedTotal, elapsedTotal, tmp.nodes, res[0], 1, bestForWhichSide);
-    }
-
-    std::cout << std::flush;
-
-    return res;
-}
-
-duration_t findBestOnSameLevel(stack_vector<Variation<>, maxMoves>& boards, i8 depth)//, PlayerSide onMove)
-{
-    AssertAssume(!boards.empty());
-    PlayerSide onMoveResearched = boards.front().board.playerOnMove;
-    depth -= 1;// boards.front().variationDepth;
-    size_t totalNodesDepth = 0;
-    duration_t timeFirstBoard(0);
-    //i8 previousDepth = std::numeric_limits<i8>::max();
-
-    for (auto& i : boards)
-    {
-        AssertAssume(i.board.playerOnMove == onMoveResearched);//Check if all boards are from the same POV. Required for the a/B to work.
-
-        if (i.variationDepth != 0) [[likely]]//If not draw by repetition
-            {
-                //previousDepth = std::min(previousDepth,i.variationDepth);
-                i.variationDepth = depth;
-            }
-
-        i.time = static_cast<duration_t>(std::numeric_limits<double>::infinity()); //To know which failed to finish
-        i.pruned = false;
-    }
-
-
-    auto timeThisStarted = std::chrono::high_resolution_clock::now();
-    if (depth > 0)
-    {
-        alphaOrBeta = kingPrice * onMoveResearched;
-        //lastReportedLowerBound = alphaOrBeta;
-        //transpositions.clear();
-
-        criticalTimeDepleted = false;
-        onMoveW = onMoveResearched;
-        //depthW = depth;
-        //q.clear();
-
-        auto oldBestMove = boards[0].firstMoveNotation;
-
-        bestMove = nullptr;
-        q = &boards;
-        qPos = 0;
-
-
-        //solvedMoves = &resultBoards;
-
-
-
-        //q.reserve(boards.size());
-        //for (auto& board : boards)
-        //    q.push_back(&board);
-
-        //if(options.MultiPV<=1)
-        //    evaluateGameMoveFromQ(qPos++, depthW);//It is usefull to run first pass on single core at full speed to set up alpha/Beta
-
-
-        workToDo = true;
-        workToDo.notify_all();
-
-
-        workerFromQ(0);//Do work on this thread
-
-        barrier->arrive_and_wait();//Wait for the workers to finish
-
-
-        stack_vector<Variation<>, maxMoves> resultBoards;
-
-        //Add the best result
-        if (bestMove != nullptr)
-        {
-            resultBoards.unchecked_push_back(*bestMove);
-        }
-
-        //Add the rest of the boards that finished computation without changing the order
-        for (auto&& i : boards)
-        {
-            if (&i != bestMove && i.time != static_cast<duration_t>(std::numeric_limits<double>::infinity()))
-                resultBoards.unchecked_push_back(std::move(i));
-            //else
-              //  debugOut << "board " << i.firstMoveNotation << " has value of infinity" << std::endl;
-        }
-
-        if (resultBoards.size() == availableMoves)
-        {
-            fullDepth = depth + 1;
-        }
-        if (resultBoards.size() != boards.size())
-        {
-            debugOut << "Not enough time to search all moves. Only managed to fully go through " << resultBoards.size() << " out of " << boards.size() << std::endl;
-
-            for (const auto& i : resultBoards)
-            {
-                if (oldBestMove == i.firstMoveNotation)
-                {
-                    debugOut << "Time ran out, but the engine at least managed to include the supposed best move in the results. Returning results." << std::endl;
-                    goto bestMoveFound;
-                }
-            }
-            debugOut << "Time ran out and the engine did not manage to include the suppossed best move. Cancelling the results." << std::endl;
-            return duration_t(std::numeric_limits<double>::infinity());
-
-        }
-    bestMoveFound:
-
-        //Determine if pruning caused some upperbound results (we cannot calculate with them the same way)
-        bool noUpperboundResults = true;
-        for (const auto& i : resultBoards)
-        {
-            if (i.pruned)
-            {
-                noUpperboundResults = false;
-                break;
-            }
-        }
-
-        if (noUpperboundResults)
-            debugOut << "All board evaluations are exact, performing sorting/shuffling!" << std::endl;
-        else
-            debugOut << "Some board evalutions are upper bound only, sorting/shuffling not possible." << std::endl;
-
-
-        //Shuffle best results if required and best result is not a draw
-        if (noUpperboundResults && resultBoards.size() > 2)
-        {
-            if (shuffle && bestMove->bestFoundValue != 0.0f)
-            {
-                std::shuffle(resultBoards.begin(), resultBoards.end(), rng);
-            }
-
-            //Sort only if we know the real value of all boards (no first level pruning occured)
-            switch (onMoveResearched)
-            {
-            case PlayerSide::WHITE: {
-                std::stable_sort(resultBoards.begin(), resultBoards.end(), std::less<Variation<>>());
-            } break;
-            case PlayerSide::BLACK: {
-                std::stable_sort(resultBoards.begin(), resultBoards.end(), std::greater<Variation<>>());
-            } break;
-            default:
-                std::unreachable();
-            }
-        }
-
-        for (const auto& i : resultBoards)
-            totalNodesDepth += i.nodes;
-
-        totalNodesAll += totalNodesDepth;
-
-        for (size_t i = 0; i < resultBoards.size() && timeFirstBoard.count() == 0; ++i)
-            timeFirstBoard = resultBoards[i].time;
-
-        if (timeFirstBoard.count() == 0) [[unlikely]] //All are 0 - all moves lead to a draw by repetition. No need to search further
-            timeFirstBoard = duration_t(std::numeric_limits<double>::infinity());
-
-        boards = std::move(resultBoards);
-    }
-    duration_t elapsedThis = std::chrono::high_resolution_clock::now() - timeThisStarted;
-    duration_t elapsedTotal = std::chrono::high_resolution_clock::now() - timeGlobalStarted;
-
-    if (options.Verbosity >= 6 || options.MultiPV > 1)
-    {
-        for (size_t i = boards.size() - 1; i != 0; --i)
-            printMoveInfo(depth + 1, elapsedTotal, elapsedThis, totalNodesDepth, boards[i], i + 1, oppositeSide(onMoveW));
-    }
-
-    if (options.Verbosity >= 1) //TODO: make it available to print later for the last depth if verbosity is set to 1, do not print every time unless >= 2.
-    {
-        printMoveInfo(depth + 1, elapsedTotal, elapsedThis, totalNodesDepth, boards.front(), 1, oppositeSide(onMoveW));
-        std::cout << std::flush;
-    }
-
-    return timeFirstBoard;
-}
-
-//std::pair<GameState, float> findBestOnTopLevel(GameState& board, i8 depth, PlayerSide onMove)
-//{
-//    auto tmp = generateMoves(board, onMove);//, onMove);
-//    findBestOnSameLevel(tmp, depth - 1);//, oppositeSide(onMove));
-//    const auto& res = tmp.front();
-//    return { res.board, res.bestFoundValue };
-//}
-
-
-
-std::string_view getWord(std::string_view& str)
-{
-    size_t i = 0;
-    for (; i < str.size(); ++i)
-    {
-        if (isspace(str[i]))
-            break;
-    }
-    auto res = str.substr(0, i);
-    if (i >= str.size())
-        str = "";
-    else
-        str = str.substr(i + 1);
-    return res;
-}
-
-void executeMove(GameState& board, std::string_view& str, stack_vector<std::array<Piece, 64>,75>& playedPositionsWhite, stack_vector<std::array<Piece, 64>, 75>& playedPositionsBlack)
-{
-    auto move = getWord(str);
-
-    auto backup = board.pieceAt(move[2], move[3]);
-    if (backup == Piece::Nothing && toGenericPiece(board.pieceAt(move[0], move[1])) != PieceGeneric::Pawn)
-    {
-        board.repeatableMoves += 1;
-
-        if (board.playerOnMove == PlayerSide::WHITE)
-            playedPositionsWhite.push_back(board.board);
-        else
-            playedPositionsBlack.push_back(board.board);
-    }
-    else
-    {
-        board.repeatableMoves = 0;
-        playedPositionsWhite.clear();
-        playedPositionsBlack.clear();
-    }
-
-    board.movePiece(move[0], move[1], move[2], move[3]);
-
-    //Castling
-    if      (move == "e1c1" && board.pieceAt(move[2], move[3]) == Piece::KingWhite)
-        board.movePiece('a', '1', 'd', '1');
-    else if (move == "e1g1" && board.pieceAt(move[2], move[3]) == Piece::KingWhite)
-        board.movePiece('h', '1', 'f', '1');
-    else if (move == "e8c8" && board.pieceAt(move[2], move[3]) == Piece::KingBlack)
-        board.movePiece('a', '8', 'd', '8');
-    else if (move == "e8g8" && board.pieceAt(move[2], move[3]) == Piece::KingBlack)
-        board.movePiece('h', '8', 'f', '8');
-
-    //Pawn promotion
-    else if (move.size() == 5)
-    {
-        char promotionChar = tolower(move[4]);
-        Piece evolvedInto = fromGenericPiece(fromGenericSymbol(promotionChar), board.playerOnMove);
-        board.pieceAt(move[2], move[3]) = evolvedInto;
-    }
-
-    //En passant
-    else if (move[1] == '5' && board.pieceAt(move[2], move[3]) == Piece::PawnWhite && move[0] != move[2] && backup == Piece::Nothing)
-    {
-        board.pieceAt(move[2], move[3] - 1) = Piece::Nothing;
-    }
-    else if (move[1] == '4' && board.pieceAt(move[2], move[3]) == Piece::PawnBlack && move[0] != move[2] && backup == Piece::Nothing)
-    {
-        board.pieceAt(move[2], move[3] + 1) = Piece::Nothing;
-    }
-
-    //Castling posibility invalidation
-    //Doesn't matter when later in the game the piece no longer stands in original position -> it must have left before
-    switch (move[0])
-    {
-    case('e'): {
-        switch (move[1])
-        {
-        case('1'):
-        {
-            //White moves king
-            board.canCastle[0][index(PlayerSide::WHITE)] = false;
-            board.canCastle[1][index(PlayerSide::WHITE)] = false;
-        } break;
-        case('8'):
-        {
-            //Black moves king
-            board.canCastle[0][index(PlayerSide::BLACK)] = false;
-            board.canCastle[1][index(PlayerSide::BLACK)] = false;
-        } break;
+﻿
+#include <array>
+#include <string>
+#include <syncstream>
+#include <fstream>
+#include <random>
+#include <cassert>
+#include <unordered_map>
+#include <iostream>
+//#include <vector>
+#include <queue>
+#include <thread>
+#include <cfloat>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <barrier>
+#include <future>
+#include <memory>
+#include <bit>
+#include <charconv>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "stack_vector.h"
+#include "stack_string.h"
+#include "perf_counters.h"
+
+//std::cout
+
+
+
+namespace KlaraDestroyer {
+std::ostream* outStream;
+#define out (*outStream)
+#define nl '\n'
+
+#define debugOut std::cerr
+//#ifdef _DEBUG std::cerr #else (void) #endif
+
+#ifdef _DEBUG
+#define AssertAssume(...)  assert(__VA_ARGS__)
+#else
+#if defined(_MSC_VER) && !defined(__clang__)
+#define AssertAssume(...)  __assume(__VA_ARGS__)
+#elif defined(__clang__)
+#define AssertAssume(...)  __builtin_assume(__VA_ARGS__)
+#else
+#define AssertAssume(...)  [[assume(__VA_ARGS__)]]
+#endif
+#endif
+
+
+
+//#define CASTLING_DISABLED
+#define RELAX_CASTLING_PREDICTIONS
+//#define SEARCH_STATS //Counts cutoffs and seldepth in the search, costs a few % of speed
+
+#ifdef SEARCH_STATS
+#define SEARCH_STAT(...) __VA_ARGS__
+#else
+#define SEARCH_STAT(...)
+#endif
+//#define COPY_MAKE //Every searched move restores the whole GameState from a copy instead of undoing the target square and the side on move
+//#define PROFILE_ZONES //Attributes the time of every thread to parts of the search, the clock reads slow it down considerably
+
+
+typedef int_fast8_t i8;
+typedef uint_fast8_t u8;
+typedef int_fast16_t i16;
+typedef uint_fast16_t u16;
+typedef int_fast32_t i32;
+typedef uint_fast32_t u32;
+typedef int_fast64_t i64;
+typedef uint_fast64_t u64;
+
+typedef std::chrono::duration<double, std::milli> duration_t;
+typedef stack_string<5> moveNotation;
+
+class GameState;
+
+typedef int32_t Score;//Centipawns, from white's point of view unless said otherwise
+
+static constexpr Score kingPrice = 20000;//Capturing the king ends the game, such scores only mark illegal moves
+static constexpr Score matePrice = 1000000;//Being mated after ply p scores -(matePrice - p), so faster mates score higher
+static constexpr Score maxMatePly = 1000;
+static constexpr Score scoreInfinite = 2000000;//Above any reachable score, marks that no legal move was found yet
+static constexpr Score scoreDraw = 0;
+
+constexpr bool isMateScore(Score score) noexcept
+{
+    return score >= matePrice - maxMatePly || score <= -(matePrice - maxMatePly);
+}
+
+constexpr Score matePly(Score score) noexcept//Plies until the mate of a mate score
+{
+    return matePrice - (score < 0 ? -score : score);
+}
+
+static constexpr size_t maxMoves = 218;
+
+#define MOVE_PIECE_FREE_ONLY std::equal_to<Score>()
+#define MOVE_PIECE_CAPTURE_ONLY std::greater<Score>()
+#define MOVE_PIECE_FREE_CAPTURE std::greater_equal<Score>()
+
+enum class PlayerSide : i8
+{
+    WHITE = 1,
+    BLACK = -1,
+    NONE = 0
+};
+
+enum class PieceGeneric : i8
+{
+    Nothing = 0,
+    Pawn = 1,//0x01,
+    Knight = 2,//0x02,
+    Bishop = 3,//0x03,
+    Rook = 4,//0x04,
+    Queen = 5,//0x05,
+    King = 6,//0x06,
+};
+
+enum class Piece : i8
+{
+    Nothing = 0,
+    PawnWhite = 1,//0x01,
+    KnightWhite = 2,//0x02,
+    BishopWhite = 3,//0x03,
+    RookWhite = 4,//0x04,
+    QueenWhite = 5,//0x05,
+    KingWhite = 6,//0x06,
+    PawnBlack = -1,//0x81,
+    KnightBlack = -2,//0x82,
+    BishopBlack = -3,//0x83,
+    RookBlack = -4,//0x84,
+    QueenBlack = -5,//0x85,
+    KingBlack = -6,//0x86
+    OffBoard = 7,//Sentinel around the board in the mailbox, never a real piece
+};
+
+constexpr float operator * (float lhs, PlayerSide rhs) noexcept
+{
+    return lhs * static_cast<i8>(rhs);
+}
+constexpr double operator * (double lhs, PlayerSide rhs) noexcept
+{
+    return lhs * static_cast<i8>(rhs);
+}
+constexpr int8_t operator * (int8_t lhs, PlayerSide rhs) noexcept
+{
+    return lhs * static_cast<i8>(rhs);
+}
+constexpr int16_t operator * (int16_t lhs, PlayerSide rhs) noexcept
+{
+    return lhs * static_cast<i8>(rhs);
+}
+constexpr int32_t operator * (int32_t lhs, PlayerSide rhs) noexcept
+{
+    return lhs * static_cast<i8>(rhs);
+}
+constexpr int64_t operator * (int64_t lhs, PlayerSide rhs) noexcept
+{
+    return lhs * static_cast<i8>(rhs);
+}
+
+constexpr inline PlayerSide operator - (PlayerSide side) noexcept
+{
+    AssertAssume(static_cast<i8>(side) == 1 || static_cast<i8>(side) == -1);
+    return static_cast<PlayerSide>(-static_cast<i8>(side));
+}
+constexpr inline PlayerSide oppositeSide(PlayerSide side) noexcept
+{
+    return -side;
+}
+
+constexpr inline i8 index(PlayerSide side) noexcept
+{
+    AssertAssume(static_cast<i8>(side) == 1 || static_cast<i8>(side) == -1);
+    return (static_cast<i8>(side) + static_cast<i8>(1)) / static_cast<i8>(2);
+}
+
+constexpr inline i8 playerDirection(PlayerSide side) noexcept
+{
+    AssertAssume(static_cast<i8>(side) == 1 || static_cast<i8>(side) == -1);
+    return static_cast<i8>(side);
+}
+
+
+constexpr PlayerSide pieceColor(Piece p)
+{
+    return static_cast<PlayerSide>(((static_cast<int8_t>(p) & static_cast <int8_t>(0x80)) >> 6) | 0x01);
+}
+constexpr PieceGeneric toGenericPiece(Piece p)
+{
+    return (PieceGeneric)((static_cast<i8>(p) >= 0) ? static_cast<i8>(p) : -static_cast<i8>(p));
+    //return static_cast<PieceGeneric>(std::abs(p));
+}
+constexpr Piece operator * (Piece lhs, PlayerSide rhs) noexcept
+{
+    return static_cast<Piece>(static_cast<i8>(lhs) * static_cast<i8>(rhs));
+}
+constexpr Piece operator * (PieceGeneric lhs, PlayerSide rhs) noexcept
+{
+    return static_cast<Piece>(static_cast<i8>(lhs) * static_cast<i8>(rhs));
+}
+
+constexpr Piece fromGenericPiece(PieceGeneric p, PlayerSide side)
+{
+    return static_cast<Piece>(p * side);
+}
+constexpr inline Piece operator - (Piece piece) noexcept
+{
+    return static_cast<Piece>(-static_cast<i8>(piece));
+}
+
+
+static constexpr size_t cacheLineSize = 64;
+static constexpr size_t maxThreads = 256;
+
+// State touched concurrently by all search threads. Fields written by different threads at different rates live on separate cache lines,
+// so that a finished root move tightening the bound does not invalidate the line every thread polls on each node.
+struct alignas(cacheLineSize) SharedSearchState
+{
+    alignas(cacheLineSize) std::atomic<Score> alphaOrBeta;//Root level bound, tightened whenever a root move finishes
+    alignas(cacheLineSize) std::atomic<size_t> qPos;//Next root move to be taken from the queue
+    alignas(cacheLineSize) std::atomic<bool> criticalTimeDepleted;//Polled on every node, written at most once per search
+    std::atomic<bool> optimalTimeDepleted;
+    std::atomic<size_t> nodeLimit;//0 = unlimited, otherwise the search stops once all threads together searched this many nodes
+    std::atomic<bool> pondering;//Searching on opponent's time, our clock starts only with ponderhit
+    std::atomic<std::chrono::steady_clock::time_point> ponderhitTime;
+};
+static SharedSearchState shared;
+
+// Parts of the search the profiler attributes time to
+enum class Zone : u8 {
+    Search,//Root move search outside of the other zones
+    MoveGen,
+    Eval,
+    Legality,
+    Ordering,
+    RootGen,
+    Barrier,
+};
+static constexpr size_t zoneCount = 7;
+static constexpr std::array<const char*, zoneCount> zoneNames = { "search", "move gen", "eval", "legality", "ordering", "root gen", "barrier" };
+
+#ifdef SEARCH_STATS
+// Search statistics of one thread. Plain counters, they are read only after the barrier, when the thread is idle.
+struct SearchStats
+{
+    size_t interiorNodes;//Nodes whose moves were searched
+    size_t cutoffs;//Nodes left early because beta <= alpha
+    size_t firstMoveCutoffs;//Cutoffs by the first move tried
+    size_t seldepth;//Deepest ply reached, the root move included
+
+    SearchStats& operator+=(const SearchStats& other) noexcept
+    {
+        interiorNodes += other.interiorNodes;
+        cutoffs += other.cutoffs;
+        firstMoveCutoffs += other.firstMoveCutoffs;
+        seldepth = std::max(seldepth, other.seldepth);
+        return *this;
+    }
+};
+static thread_local std::array<unsigned, 130> movesTried;//Moves tried so far by the node at each depth (index = depth of the node), to recognize first move cutoffs
+#endif
+
+// Per-thread counters, written only by the owning thread and summed lazily by whoever reports them
+struct alignas(cacheLineSize) ThreadStats
+{
+    std::atomic<size_t> nodes;
+    std::atomic<duration_t> barrierWait;//Time spent waiting for the other threads to finish their root moves
+    SEARCH_STAT(SearchStats search;)
+#ifdef PROFILE_ZONES
+    std::array<std::atomic<size_t>, zoneCount> zoneCalls;
+    std::array<std::atomic<duration_t>, zoneCount> zoneTime;//Exclusive, nested zones are not included
+#endif
+
+    void addNodes(size_t count) noexcept
+    {
+        nodes.store(nodes.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);//Single writer, no need for a locked add
+    }
+
+    void addBarrierWait(duration_t time) noexcept
+    {
+        barrierWait.store(barrierWait.load(std::memory_order_relaxed) + time, std::memory_order_relaxed);
+    }
+};
+static std::array<ThreadStats, maxThreads> threadStats;
+static thread_local ThreadStats* localStats = &threadStats[0];//Counters of the thread running the code, workers switch to their own
+
+size_t searchedNodes() noexcept
+{
+    size_t res = 0;
+    for (const auto& i : threadStats)
+        res += i.nodes.load(std::memory_order_relaxed);
+    return res;
+}
+
+duration_t barrierWaitTotal() noexcept
+{
+    duration_t res(0);
+    for (const auto& i : threadStats)
+        res += i.barrierWait.load(std::memory_order_relaxed);
+    return res;
+}
+
+void resetThreadStats() noexcept
+{
+    for (auto& i : threadStats)
+    {
+        i.nodes.store(0, std::memory_order_relaxed);
+        i.barrierWait.store(duration_t(0), std::memory_order_relaxed);
+        SEARCH_STAT(i.search = {};)
+#ifdef PROFILE_ZONES
+        for (size_t z = 0; z < zoneCount; ++z)
+        {
+            i.zoneCalls[z].store(0, std::memory_order_relaxed);
+            i.zoneTime[z].store(duration_t(0), std::memory_order_relaxed);
+        }
+#endif
+    }
+}
+
+#ifdef PROFILE_ZONES
+// Measures the time spent in a zone until the end of the scope. Time of nested zones goes only to them,
+// so the zones of recursive code add up to the thread's time. Waiting for work outside of any zone is not counted.
+class ProfileZone
+{
+    struct ThreadZones
+    {
+        stack_vector<Zone, 1024> open;
+        std::chrono::steady_clock::time_point lastSwitch;
+    };
+    static inline thread_local ThreadZones zones;
+
+    static void charge(Zone zone, std::chrono::steady_clock::time_point now) noexcept
+    {
+        auto& time = localStats->zoneTime[(size_t)zone];
+        time.store(time.load(std::memory_order_relaxed) + (now - zones.lastSwitch), std::memory_order_relaxed);
+        zones.lastSwitch = now;
+    }
+public:
+    explicit ProfileZone(Zone zone) noexcept
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (!zones.open.empty())
+            charge(zones.open.back(), now);
+        else
+            zones.lastSwitch = now;
+        zones.open.push_back(zone);
+        auto& calls = localStats->zoneCalls[(size_t)zone];
+        calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    ~ProfileZone()
+    {
+        charge(zones.open.back(), std::chrono::steady_clock::now());
+        zones.open.pop_back();
+    }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+};
+#define PROFILE_ZONE_NAME(line) profileZone##line
+#define PROFILE_ZONE_AT(zone, line) ProfileZone PROFILE_ZONE_NAME(line)(zone)
+#define PROFILE_ZONE(zone) PROFILE_ZONE_AT(zone, __LINE__)
+
+// Time of every zone per thread (only threads that ran something), the total, its share and the cost per call
+void printZoneProfile(std::ostream& os)
+{
+    std::array<bool, maxThreads> used{};
+    size_t lastUsed = 0;
+    duration_t total(0);
+    for (size_t t = 0; t < maxThreads; ++t)
+    {
+        for (size_t z = 0; z < zoneCount; ++z)
+        {
+            const auto time = threadStats[t].zoneTime[z].load(std::memory_order_relaxed);
+            if (time.count() > 0)
+            {
+                used[t] = true;
+                lastUsed = t;
+                total += time;
+            }
+        }
+    }
+
+    os << std::left << std::setw(10) << "zone" << std::right;
+    for (size_t t = 0; t <= lastUsed; ++t)
+        if (used[t])
+            os << std::setw(10) << ("t" + std::to_string(t) + " ms");
+    os << std::setw(12) << "total ms" << std::setw(8) << "share" << std::setw(14) << "calls" << std::setw(12) << "ns/call" << nl;
+
+    for (size_t z = 0; z < zoneCount; ++z)
+    {
+        duration_t zoneTotal(0);
+        size_t calls = 0;
+        os << std::left << std::setw(10) << zoneNames[z] << std::right << std::fixed << std::setprecision(1);
+        for (size_t t = 0; t <= lastUsed; ++t)
+        {
+            const auto time = threadStats[t].zoneTime[z].load(std::memory_order_relaxed);
+            zoneTotal += time;
+            calls += threadStats[t].zoneCalls[z].load(std::memory_order_relaxed);
+            if (used[t])
+                os << std::setw(10) << time.count();
+        }
+        os << std::setw(12) << zoneTotal.count()
+            << std::setw(7) << (total.count() > 0 ? 100 * zoneTotal / total : 0) << '%'
+            << std::setw(14) << calls
+            << std::setw(12) << (calls ? zoneTotal.count() * 1000000 / calls : 0) << nl;
+    }
+    os << std::flush;
+}
+#else
+#define PROFILE_ZONE(zone)
+#endif
+
+#ifdef SEARCH_STATS
+SearchStats searchStatsTotal() noexcept
+{
+    SearchStats res{};
+    for (const auto& i : threadStats)
+        res += i.search;
+    return res;
+}
+#endif
+
+static bool perfCountersEnabled = false;//Hardware counters cost a few syscalls per thread, so they are opened only when asked for
+static std::array<perf_counters::values, maxThreads> perfTotals;//Counters of the threads that already ended, by thread id
+static std::mutex perfTotalsM;
+
+// Counts the hardware events of the current thread while it lives and adds them to perfTotals when it ends
+class ThreadPerfScope
+{
+    perf_counters counters;
+    size_t threadId;
+public:
+    ThreadPerfScope(size_t threadId) : threadId(threadId)
+    {
+        if (perfCountersEnabled)
+            counters.open();
+    }
+    ~ThreadPerfScope()
+    {
+        if (!perfCountersEnabled)
+            return;
+        auto values = counters.read();
+        std::lock_guard l(perfTotalsM);
+        perfTotals[threadId] += values;
+    }
+};
+
+void resetPerfTotals()
+{
+    std::lock_guard l(perfTotalsM);
+    perfTotals.fill({});
+}
+
+// Timeline of the search in the Chrome trace event format (chrome://tracing, ui.perfetto.dev), enabled by the TraceFile option.
+// Every thread records into its own buffer and the buffers are written out after bestmove, appending to one file for the whole session.
+enum class TraceKind : u8 {
+    RootMove,//One root move searched by a thread
+    Barrier,//Waiting for the other threads to finish the iteration
+    Iteration,//One iteration of uciGo
+    TimeDecision,//Whether the time manager lets the next iteration start
+};
+
+struct TraceEvent
+{
+    TraceKind kind = {};
+    std::chrono::steady_clock::time_point start = {};
+    duration_t duration = {};
+    moveNotation move = {};
+    int depth = {};
+    size_t nodes = {};
+    bool flag = {};//Pruned root move, or the decision to continue
+    Score score = {};
+    duration_t soft = {};
+    duration_t hard = {};
+};
+
+struct TraceBuffer
+{
+    std::mutex m;//Workers record their barrier wait after being released, possibly while the buffers are written out
+    std::unique_ptr<TraceEvent[]> events;
+    size_t size;
+    size_t dropped;
+    bool named;
+};
+static constexpr size_t traceBufferCapacity = 1 << 16;//Per thread and search, the rest is dropped
+static std::array<TraceBuffer, maxThreads> traceBuffers;
+static std::ofstream traceFile;
+static std::chrono::steady_clock::time_point traceOrigin;
+static std::atomic<bool> traceEnabled = false;
+
+void traceOpen(std::string_view path)
+{
+    traceEnabled = false;
+    traceFile.close();
+    if (path.empty() || path == "<empty>")
+        return;
+    traceFile.open(std::string(path), std::ios::trunc);
+    if (!traceFile)
+    {
+        debugOut << "Cannot open trace file " << path << std::endl;
+        return;
+    }
+    traceFile << "[\n";//The closing bracket is optional in the JSON array format, so that the file can be appended to until the end
+    traceOrigin = std::chrono::steady_clock::now();
+    for (auto& i : traceBuffers)
+        i.named = false;
+    traceEnabled = true;
+}
+
+void traceRecord(size_t threadId, const TraceEvent& event)
+{
+    auto& buffer = traceBuffers[threadId];
+    std::lock_guard l(buffer.m);
+    if (!buffer.events)
+        buffer.events = std::make_unique<TraceEvent[]>(traceBufferCapacity);
+    if (buffer.size == traceBufferCapacity) [[unlikely]]
+        ++buffer.dropped;
+    else
+        buffer.events[buffer.size++] = event;
+}
+
+void traceRootMove(size_t threadId, std::chrono::steady_clock::time_point start, const moveNotation& move, int depth, size_t nodes, bool pruned)
+{
+    if (traceEnabled.load(std::memory_order_relaxed)) [[unlikely]]
+        traceRecord(threadId, { .kind = TraceKind::RootMove, .start = start, .duration = std::chrono::steady_clock::now() - start, .move = move, .depth = depth, .nodes = nodes, .flag = pruned });
+}
+
+void traceBarrier(size_t threadId, std::chrono::steady_clock::time_point start)
+{
+    if (traceEnabled.load(std::memory_order_relaxed)) [[unlikely]]
+        traceRecord(threadId, { .kind = TraceKind::Barrier, .start = start, .duration = std::chrono::steady_clock::now() - start });
+}
+
+void traceIteration(duration_t iterationTime, const moveNotation& best, int depth, size_t nodes, Score score, duration_t soft, duration_t hard)
+{
+    if (traceEnabled.load(std::memory_order_relaxed)) [[unlikely]]
+        traceRecord(0, { .kind = TraceKind::Iteration, .start = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(iterationTime), .duration = iterationTime, .move = best, .depth = depth, .nodes = nodes, .score = score, .soft = soft, .hard = hard });
+}
+
+void traceTimeDecision(bool startNext, duration_t projected, duration_t soft)
+{
+    if (traceEnabled.load(std::memory_order_relaxed)) [[unlikely]]
+        traceRecord(0, { .kind = TraceKind::TimeDecision, .start = std::chrono::steady_clock::now(), .duration = projected, .flag = startNext, .soft = soft });
+}
+
+//Writes out and clears the buffers of all threads
+void traceFlush()
+{
+    if (!traceEnabled)
+        return;
+    auto us = [](duration_t time) { return time.count() * 1000; };
+    auto number = [](double value) { return std::isfinite(value) ? std::to_string(value) : std::string("null"); };//No time limit is infinite, JSON has no infinity
+    traceFile << std::fixed << std::setprecision(3);
+    for (size_t t = 0; t < maxThreads; ++t)
+    {
+        auto& buffer = traceBuffers[t];
+        std::lock_guard l(buffer.m);
+        if (buffer.size == 0)
+            continue;
+        if (!buffer.named)
+        {
+            traceFile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":\"" << (t == 0 ? "search" : "worker ") << (t == 0 ? "" : std::to_string(t)) << "\"}},\n";
+            buffer.named = true;
+        }
+        for (size_t i = 0; i < buffer.size; ++i)
+        {
+            const auto& e = buffer.events[i];
+            const double ts = us(e.start - traceOrigin);
+            switch (e.kind)
+            {
+            case TraceKind::RootMove:
+                traceFile << "{\"name\":\"" << e.move << "\",\"cat\":\"root\",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << us(e.duration)
+                    << ",\"pid\":1,\"tid\":" << t << ",\"args\":{\"depth\":" << e.depth << ",\"nodes\":" << e.nodes << ",\"pruned\":" << (e.flag ? "true" : "false") << "}},\n";
+                break;
+            case TraceKind::Barrier:
+                traceFile << "{\"name\":\"barrier\",\"cat\":\"wait\",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << us(e.duration)
+                    << ",\"pid\":1,\"tid\":" << t << "},\n";
+                break;
+            case TraceKind::Iteration:
+                traceFile << "{\"name\":\"depth " << e.depth << "\",\"cat\":\"iteration\",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << us(e.duration)
+                    << ",\"pid\":1,\"tid\":" << t << ",\"args\":{\"best\":\"" << e.move << "\",\"score\":" << e.score << ",\"nodes\":" << e.nodes
+                    << ",\"soft ms\":" << number(e.soft.count()) << ",\"hard ms\":" << number(e.hard.count()) << "}},\n";
+                break;
+            case TraceKind::TimeDecision:
+                traceFile << "{\"name\":\"" << (e.flag ? "continue" : "stop") << "\",\"cat\":\"tm\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ts
+                    << ",\"pid\":1,\"tid\":" << t << ",\"args\":{\"projected ms\":" << number(e.duration.count()) << ",\"soft ms\":" << number(e.soft.count()) << "}},\n";
+                break;
+            }
+        }
+        if (buffer.dropped != 0)
+            debugOut << "Trace buffer of thread " << t << " was full, " << buffer.dropped << " events dropped" << std::endl;
+        buffer.size = 0;
+        buffer.dropped = 0;
+    }
+    traceFile << std::flush;
+}
+
+static constexpr size_t nodesPublishMask = 1024 - 1;//Searches publish their node count every 1024 nodes
+
+static i8 fullDepth;
+static i8 availableMoves;
+static PlayerSide onMoveW;
+static bool shuffle;
+static std::chrono::steady_clock::time_point timeGlobalStarted;
+//static std::chrono::steady_clock::time_point timeDepthStarted;
+static constexpr i8 depthToStopOrderingPieces = 3;
+static constexpr i8 depthToStopOrderingMoves = 3;
+
+// Relax castling restrictions after certain depth. 0=full rules check only for next engines move, 1=also full check enemy move, 2=also full check engines second move, etc.
+// Set to at least 1 (to avoid obvious checkmate possibility)
+static constexpr i8 castlingMaxDepth = 2; 
+
+// The bound is only a pruning hint, a stale value costs some nodes but never correctness. Relaxed ordering is therefore enough.
+template<typename T>
+inline void update_max(std::atomic<T>& atom, const T& val)
+{
+    for (T atom_val = atom.load(std::memory_order_relaxed); atom_val < val && !atom.compare_exchange_weak(atom_val, val, std::memory_order_relaxed););
+}
+
+template<typename T>
+inline void update_min(std::atomic<T>& atom, const T& val)
+{
+    for (T atom_val = atom.load(std::memory_order_relaxed); atom_val > val && !atom.compare_exchange_weak(atom_val, val, std::memory_order_relaxed););
+}
+
+
+struct Options {
+    size_t MultiPV;
+    size_t Threads;
+    size_t Verbosity;
+    bool UCI_Chess960;
+    bool Ponder;
+};
+
+static Options options;
+static bool firstLevelPruning = true;
+
+
+constexpr i8 oneColumn = 1;
+constexpr inline i8 column(i8 indexOnBoard) noexcept
+{
+    return indexOnBoard % 8;
+}
+constexpr i8 oneRow = 8;
+constexpr inline i8 row(i8 indexOnBoard) noexcept
+{
+    return indexOnBoard / 8;
+}
+constexpr inline i8 toIndex(i8 column, i8 row) noexcept
+{
+    return row * oneRow + column * oneColumn;
+}
+
+//10x12 mailbox: the board with off-board sentinels around it. One sentinel column on each side (shared by neighbouring rows) and two sentinel rows
+//at the top and the bottom are enough for every move to stop on a sentinel, so the move generation needs no coordinate checks.
+constexpr i8 mailboxWidth = 10;
+constexpr i8 mailboxSize = 120;
+constexpr inline i8 toMailbox(i8 column, i8 row) noexcept
+{
+    return (row + 2) * mailboxWidth + column + 1;
+}
+constexpr inline i8 mailboxColumn(i8 square) noexcept
+{
+    return square % mailboxWidth - 1;
+}
+constexpr inline i8 mailboxRow(i8 square) noexcept
+{
+    return square / mailboxWidth - 2;
+}
+
+//Mailbox squares of the board, a1 to h8
+constexpr std::array<i8, 64> boardSquares = [] {
+    std::array<i8, 64> res{};
+    for (i8 i = 0; i < 64; ++i)
+        res[i] = toMailbox(column(i), row(i));
+    return res;
+}();
+
+//Index on the 8x8 board of every mailbox square, -1 for the sentinels
+constexpr std::array<i8, mailboxSize> mailboxToIndex = [] {
+    std::array<i8, mailboxSize> res{};
+    res.fill(-1);
+    for (i8 i = 0; i < 64; ++i)
+        res[boardSquares[i]] = i;
+    return res;
+}();
+
+
+template <typename T>
+class TempSwap
+{
+    T& toSwap;
+    T backup;
+public:
+    TempSwap(T& toSwap, T tempNewValue) : toSwap(toSwap), backup(toSwap)
+    {
+        toSwap = std::forward<T>(tempNewValue);
+    }
+    ~TempSwap()
+    {
+        toSwap = backup;
+    }
+};
+
+
+
+constexpr wchar_t symbolW(Piece p)
+{
+    switch (p)
+    {
+    case Piece::Nothing:
+        return L' ';
+    case Piece::PawnWhite:
+        return L'♙';
+    case Piece::KnightWhite:
+        return L'♘';
+    case Piece::BishopWhite:
+        return  L'♗';
+    case Piece::RookWhite:
+        return L'♖';
+    case Piece::QueenWhite:
+        return L'♕';
+    case Piece::KingWhite:
+        return L'♔';
+    case Piece::PawnBlack:
+        return L'♟';
+    case Piece::KnightBlack:
+        return L'♞';
+    case Piece::BishopBlack:
+        return L'♝';
+    case Piece::RookBlack:
+        return L'♜';
+    case Piece::QueenBlack:
+        return L'♛';
+    case Piece::KingBlack:
+        return L'♚';
+    default:
+        std::unreachable();
+    }
+}
+
+constexpr char symbolA(Piece p)
+{
+    switch (p)
+    {
+    case Piece::Nothing:
+        return ' ';
+    case Piece::PawnWhite:
+        return 'P';
+    case Piece::KnightWhite:
+        return 'N';
+    case Piece::BishopWhite:
+        return 'B';
+    case Piece::RookWhite:
+        return 'R';
+    case Piece::QueenWhite:
+        return 'Q';
+    case Piece::KingWhite:
+        return 'K';
+    case Piece::PawnBlack:
+        return 'p';
+    case Piece::KnightBlack:
+        return 'n';
+    case Piece::BishopBlack:
+        return 'b';
+    case Piece::RookBlack:
+        return 'r';
+    case Piece::QueenBlack:
+        return 'q';
+    case Piece::KingBlack:
+        return 'k';
+    default:
+        std::unreachable();
+    }
+}
+constexpr char symbolA(PieceGeneric p)
+{
+    switch (p)
+    {
+    case PieceGeneric::Nothing:
+        return ' ';
+    case PieceGeneric::Pawn:
+        return 'p';
+    case PieceGeneric::Knight:
+        return 'n';
+    case PieceGeneric::Bishop:
+        return 'b';
+    case PieceGeneric::Rook:
+        return 'r';
+    case PieceGeneric::Queen:
+        return 'q';
+    case PieceGeneric::King:
+        return 'k';
+    default:
+        std::unreachable();
+    }
+}
+
+constexpr Piece fromSymbol(char a)
+{
+    switch (a)
+    {
+    case ' ':
+        return Piece::Nothing;
+    case 'P':
+        return Piece::PawnWhite;
+    case 'N':
+        return Piece::KnightWhite;
+    case 'B':
+        return Piece::BishopWhite;
+    case 'R':
+        return Piece::RookWhite;
+    case 'Q':
+        return Piece::QueenWhite;
+    case 'K':
+        return Piece::KingWhite;
+    case 'p':
+        return Piece::PawnBlack;
+    case 'n':
+        return Piece::KnightBlack;
+    case 'b':
+        return Piece::BishopBlack;
+    case 'r':
+        return Piece::RookBlack;
+    case 'q':
+        return Piece::QueenBlack;
+    case 'k':
+        return Piece::KingBlack;
+    default:
+        std::unreachable();
+    }
+}
+
+constexpr PieceGeneric fromGenericSymbol(char a)
+{
+    switch (a)
+    {
+    case ' ':
+        return PieceGeneric::Nothing;
+    case 'p':
+        return PieceGeneric::Pawn;
+    case 'n':
+        return PieceGeneric::Knight;
+    case 'b':
+        return PieceGeneric::Bishop;
+    case 'r':
+        return PieceGeneric::Rook;
+    case 'q':
+        return PieceGeneric::Queen;
+    case 'k':
+        return PieceGeneric::King;
+    default:
+        std::unreachable();
+    }
+}
+
+constexpr auto pesto_mg(PieceGeneric p)
+{
+    constexpr std::array<std::array<int16_t, 64>, 7> prices =
+    {{
+        {//case PieceGeneric::Nothing:
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+        },
+        {//case PieceGeneric::Pawn:
+0,   0,   0,   0,   0,   0,  0,   0,
+98, 134,  61,  95,  68, 126, 34, -11,
+-6,   7,  26,  31,  65,  56, 25, -20,
+-14,  13,   6,  21,  23,  12, 17, -23,
+-27,  -2,  -5,  12,  17,   6, 10, -25,
+-26,  -4,  -4, -10,   3,   3, 33, -12,
+-35,  -1, -20, -23, -15,  24, 38, -22,
+  0,   0,   0,   0,   0,   0,  0,   0,
+        },
+        {//case PieceGeneric::Knight:
+-167, -89, -34, -49,  61, -97, -15, -107,
+ -73, -41,  72,  36,  23,  62,   7,  -17,
+ -47,  60,  37,  65,  84, 129,  73,   44,
+  -9,  17,  19,  53,  37,  69,  18,   22,
+ -13,   4,  16,  13,  28,  19,  21,   -8,
+ -23,  -9,  12,  10,  19,  17,  25,  -16,
+ -29, -53, -12,  -3,  -1,  18, -14,  -19,
+-105, -21, -58, -33, -17, -28, -19,  -23,
+        },
+        {//case PieceGeneric::Bishop:
+-29,   4, -82, -37, -25, -42,   7,  -8,
+-26,  16, -18, -13,  30,  59,  18, -47,
+-16,  37,  43,  40,  35,  50,  37,  -2,
+ -4,   5,  19,  50,  37,  37,   7,  -2,
+ -6,  13,  13,  26,  34,  12,  10,   4,
+  0,  15,  15,  15,  14,  27,  18,  10,
+  4,  15,  16,   0,   7,  21,  33,   1,
+-33,  -3, -14, -21, -13, -12, -39, -21,
+        },
+        {//case PieceGeneric::Rook:
+32,  42,  32,  51, 63,  9,  31,  43,
+27,  32,  58,  62, 80, 67,  26,  44,
+-5,  19,  26,  36, 17, 45,  61,  16,
+-24, -11,   7,  26, 24, 35,  -8, -20,
+-36, -26, -12,  -1,  9, -7,   6, -23,
+-45, -25, -16, -17,  3,  0,  -5, -33,
+-44, -16, -20,  -9, -1, 11,  -6, -71,
+-19, -13,   1,  17, 16,  7, -37, -26,
+        },
+        {//case PieceGeneric::Queen:
+-28,   0,  29,  12,  59,  44,  43,  45,
+-24, -39,  -5,   1, -16,  57,  28,  54,
+-13, -17,   7,   8,  29,  56,  47,  57,
+-27, -27, -16, -16,  -1,  17,  -2,   1,
+ -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+-14,   2, -11,  -2,  -5,   2,  14,   5,
+-35,  -8,  11,   2,   8,  15,  -3,   1,
+ -1, -18,  -9,  10, -15, -25, -31, -50,
+        },
+        {//case PieceGeneric::King:
+-65,  23,  16, -15, -56, -34,   2,  13,
+ 29,  -1, -20,  -7,  -8,  -4, -38, -29,
+ -9,  24,   2, -16, -20,   6,  22, -22,
+-17, -20, -12, -27, -30, -25, -14, -36,
+-49,  -1, -27, -39, -46, -44, -33, -51,
+-14, -14, -22, -46, -44, -30, -15, -27,
+  1,   7,  -8, -64, -43, -16,   9,   8,
+-15,  36,  12, -54,   8, -28,  24,  14,
+        }
+    }};
+
+    return prices[(i8)p];
+}
+constexpr auto pesto_eg(PieceGeneric p)
+{
+    constexpr std::array<std::array<int16_t, 64>, 7> prices =
+    { {
+        {//case PieceGeneric::Nothing:
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+0,   0,   0,   0,   0,   0,  0,   0,
+        },
+        {//case PieceGeneric::Pawn:
+      0,   0,   0,   0,   0,   0,   0,   0,
+    178, 173, 158, 134, 147, 132, 165, 187,
+     94, 100,  85,  67,  56,  53,  82,  84,
+     32,  24,  13,   5,  -2,   4,  17,  17,
+     13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+      4,   7,  -6,   1,   0,  -5,  -1,  -8,
+     13,   8,   8,  10,  13,   0,   2,  -7,
+      0,   0,   0,   0,   0,   0,   0,   0,
+        },
+        {//case PieceGeneric::Knight:
+    -58, -38, -13, -28, -31, -27, -63, -99,
+    -25,  -8, -25,  -2,  -9, -25, -24, -52,
+    -24, -20,  10,   9,  -1,  -9, -19, -41,
+    -17,   3,  22,  22,  22,  11,   8, -18,
+    -18,  -6,  16,  25,  16,  17,   4, -18,
+    -23,  -3,  -1,  15,  10,  -3, -20, -22,
+    -42, -20, -10,  -5,  -2, -20, -23, -44,
+    -29, -51, -23, -15, -22, -18, -50, -64,
+        },
+        {//case PieceGeneric::Bishop:
+    -14, -21, -11,  -8, -7,  -9, -17, -24,
+     -8,  -4,   7, -12, -3, -13,  -4, -14,
+      2,  -8,   0,  -1, -2,   6,   0,   4,
+     -3,   9,  12,   9, 14,  10,   3,   2,
+     -6,   3,  13,  19,  7,  10,  -3,  -9,
+    -12,  -3,   8,  10, 13,   3,  -7, -15,
+    -14, -18,  -7,  -1,  4,  -9, -15, -27,
+    -23,  -9, -23,  -5, -9, -16,  -5, -17,
+        },
+        {//case PieceGeneric::Rook:
+    13, 10, 18, 15, 12,  12,   8,   5,
+    11, 13, 13, 11, -3,   3,   8,   3,
+     7,  7,  7,  5,  4,  -3,  -5,  -3,
+     4,  3, 13,  1,  2,   1,  -1,   2,
+     3,  5,  8,  4, -5,  -6,  -8, -11,
+    -4,  0, -5, -1, -7, -12,  -8, -16,
+    -6, -6,  0,  2, -9,  -9, -11,  -3,
+    -9,  2,  3, -1, -5, -13,   4, -20,
+        },
+        {//case PieceGeneric::Queen:
+     -9,  22,  22,  27,  27,  19,  10,  20,
+    -17,  20,  32,  41,  58,  25,  30,   0,
+    -20,   6,   9,  49,  47,  35,  19,   9,
+      3,  22,  24,  45,  57,  40,  57,  36,
+    -18,  28,  19,  47,  31,  34,  39,  23,
+    -16, -27,  15,   6,   9,  17,  10,   5,
+    -22, -23, -30, -16, -16, -23, -36, -32,
+    -33, -28, -22, -43,  -5, -32, -20, -41,
+        },
+        {//case PieceGeneric::King:
+    -74, -35, -18, -18, -11,  15,   4, -17,
+    -12,  17,  14,  17,  17,  38,  23,  11,
+     10,  17,  23,  15,  20,  45,  44,  13,
+     -8,  22,  24,  27,  26,  33,  26,   3,
+    -18,  -4,  21,  24,  27,  23,   9, -11,
+    -19,  -3,  11,  21,  23,  16,   7,  -9,
+    -27, -11,   4,  13,  14,   4,  -5, -17,
+    -53, -34, -21, -11, -28, -14, -24, -43
+        }
+    } };
+
+    return prices[(i8)p];
+}
+
+//PeSTO material, the king is never captured, so it has none (it still has its square tables)
+constexpr std::array<Score, 7> materialMg = { 0, 82, 337, 365, 477, 1025, 0 };
+constexpr std::array<Score, 7> materialEg = { 0, 94, 281, 297, 512,  936, 0 };
+
+//Contribution of the pieces to the game phase, all of them together on the board are phaseMidgame
+constexpr std::array<i8, 7> phaseWeight = { 0, 0, 1, 1, 2, 4, 0 };
+constexpr Score phaseMidgame = 24;
+
+//Middlegame and endgame score packed in one integer (endgame in the upper half), so that both are updated by one addition
+constexpr int32_t packScore(Score mg, Score eg)
+{
+    return int32_t(uint32_t(eg) << 16) + mg;
+}
+constexpr Score mgScore(int32_t score)
+{
+    return int16_t(uint16_t(uint32_t(score)));
+}
+constexpr Score egScore(int32_t score)
+{
+    return int16_t(uint16_t((uint32_t(score) + 0x8000) >> 16));//The rounding undoes the borrow of a negative middlegame half
+}
+
+//Packed material and square value of every piece on every mailbox square from white's point of view, indexed by piece + 6
+constexpr auto pieceSquareScores = []() {
+    std::array<std::array<int32_t, mailboxSize>, 13> res{};
+    for (i8 p = -6; p <= 6; ++p)
+        for (i8 i = 0; i < 64; ++i)
+        {
+            const i8 generic = p < 0 ? -p : p;
+            const i8 pestoIndex = p < 0 ? i : i ^ toIndex(0, 7);//The tables are from black's point of view (rank 8 first), white mirrors the row
+            const Score mg = materialMg[generic] + pesto_mg((PieceGeneric)generic)[pestoIndex];
+            const Score eg = materialEg[generic] + pesto_eg((PieceGeneric)generic)[pestoIndex];
+            res[p + 6][boardSquares[i]] = p < 0 ? packScore(-mg, -eg) : packScore(mg, eg);
+        }
+    return res;
+    }();
+
+constexpr int32_t pieceSquareScore(Piece p, i8 square)
+{
+    return pieceSquareScores[static_cast<i8>(p) + 6][square];
+}
+
+//phaseWeight indexed by piece + 6, padded to 16 bytes to serve as a byte shuffle table
+alignas(16) constexpr auto piecePhaseWeights = []() {
+    std::array<i8, 16> res{};
+    for (i8 p = -6; p <= 6; ++p)
+        res[p + 6] = phaseWeight[p < 0 ? -p : p];
+    return res;
+    }();
+
+constexpr i8 piecePhaseWeight(Piece p)
+{
+    return piecePhaseWeights[static_cast<i8>(p) + 6];
+}
+
+//Blend of the middlegame and endgame score by the game phase
+constexpr Score taperedScore(Score mg, Score eg, Score phase)
+{
+    phase = std::min(phase, phaseMidgame);//Promotions can raise the phase above the starting one
+    return (mg * phase + eg * (phaseMidgame - phase)) / phaseMidgame;
+}
+
+//Material used to classify the moves (free field, capture, capture of the king), the king is worth kingPrice
+constexpr Score pricePiece(PieceGeneric p)
+{
+    constexpr std::array<Score, 7> prices = { 0, 82, 337, 365, 477, 1025, kingPrice };
+    return prices[(i8)p];
+}
+
+constexpr Score pricePiece(Piece p)
+{
+    return pricePiece(toGenericPiece(p));
+}
+
+std::ostream& printPiece(Piece p, std::ostream& os) {
+    return os << symbolA(p);
+}
+std::wostream& printPiece(Piece p, std::wostream& os) {
+    return os << symbolW(p);
+}
+
+constexpr i8 promoteRow(PlayerSide s) {
+    switch (s)
+    {
+    case PlayerSide::WHITE:
+        return 7;
+    case PlayerSide::BLACK:
+        return 0;
+    default:
+        std::unreachable();
+    }
+}
+
+constexpr i8 initialRow(Piece p) {
+    switch (p)
+    {
+    case Piece::PawnWhite:
+        return 1;
+    case Piece::KnightWhite:
+    case Piece::BishopWhite:
+    case Piece::RookWhite:
+    case Piece::QueenWhite:
+    case Piece::KingWhite:
+        return 0;
+    case Piece::PawnBlack:
+        return 6;
+    case Piece::KnightBlack:
+    case Piece::BishopBlack:
+    case Piece::RookBlack:
+    case Piece::QueenBlack:
+    case Piece::KingBlack:
+        return 7;
+    default:
+        std::unreachable();
+    }
+}
+
+constexpr std::array<Piece, 4> availablePromotes(Piece p)
+{
+    AssertAssume(toGenericPiece(p) == PieceGeneric::Pawn);
+
+    constexpr std::array<std::array<Piece, 4>, 2> evolveLastRow{ {{ Piece::QueenBlack, Piece::RookBlack, Piece::BishopBlack, Piece::KnightBlack } , { Piece::QueenWhite, Piece::RookWhite, Piece::BishopWhite, Piece::KnightWhite }} };
+
+    static_assert(index(PlayerSide::BLACK) == 0 && index(PlayerSide::WHITE) == 1); // We are assuming this in the array above
+
+    static_assert((i8)Piece::PawnWhite == 1 && (i8)Piece::PawnBlack == -1); // With the hack that we are doing in the next step, we need the pawns to be 1 and -1.
+
+    return evolveLastRow[index((PlayerSide)p)];
+}
+
+//Column and row offsets of the moves of every piece kind (except pawns), in the order the search tries them
+constexpr std::array<std::pair<i8, i8>, 8> knightJumps{ { {1, 2}, {1, -2}, {2, 1}, {2, -1}, {-1, 2}, {-1, -2}, {-2, 1}, {-2, -1} } };
+constexpr std::array<std::pair<i8, i8>, 8> kingSteps{ { {1, 1}, {1, 0}, {1, -1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, 1}, {0, -1} } };
+constexpr std::array<std::pair<i8, i8>, 4> bishopRays{ { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} } };
+constexpr std::array<std::pair<i8, i8>, 4> rookRays{ { {0, 1}, {0, -1}, {1, 0}, {-1, 0} } };
+constexpr std::array<std::pair<i8, i8>, 8> queenRays{ { {1, 1}, {1, -1}, {-1, 1}, {-1, -1}, {0, 1}, {0, -1}, {1, 0}, {-1, 0} } };
+
+template <PieceGeneric piece>
+constexpr const auto& moveOffsets()
+{
+    if constexpr (piece == PieceGeneric::Knight)
+        return knightJumps;
+    else if constexpr (piece == PieceGeneric::King)
+        return kingSteps;
+    else if constexpr (piece == PieceGeneric::Bishop)
+        return bishopRays;
+    else if constexpr (piece == PieceGeneric::Rook)
+        return rookRays;
+    else
+    {
+        static_assert(piece == PieceGeneric::Queen, "Pawns have no offset table");
+        return queenRays;
+    }
+}
+
+template <PieceGeneric piece>
+constexpr bool isSlider = piece == PieceGeneric::Bishop || piece == PieceGeneric::Rook || piece == PieceGeneric::Queen;
+
+template <PieceGeneric piece>
+constexpr auto mailboxOffsets = [] {
+    constexpr auto& offsets = moveOffsets<piece>();
+    std::array<i8, offsets.size()> res{};
+    for (size_t i = 0; i < offsets.size(); ++i)
+        res[i] = offsets[i].first + offsets[i].second * mailboxWidth;
+    return res;
+}();
+
+//Calls target(square) for every mailbox square the piece can move to. Sliders continue along a ray while target returns true (the square was empty),
+//a ray always ends on a piece or a sentinel. The offsets are unrolled at compile time, so every piece kind gets its own straight-line kernel.
+template <PieceGeneric piece, typename F>
+inline void forEachTarget(i8 square, F&& target)
+{
+    constexpr auto& offsets = mailboxOffsets<piece>;
+    [&]<size_t... direction>(std::index_sequence<direction...>) {
+        if constexpr (isSlider<piece>)
+            (..., [&] { for (i8 to = square + offsets[direction]; target(to); to += offsets[direction]); }());
+        else
+            (..., target(square + offsets[direction]));
+    }(std::make_index_sequence<offsets.size()>{});
+}
+
+moveNotation toMoveNotation(i8 columnFrom, i8 rowFrom, i8 columnTo, i8 rowTo, Piece moved, Piece placed)
+{
+    std::array<char, 6> res = { 0 };
+    res[0] = columnFrom + 'a';
+    res[1] = rowFrom + '1';
+    res[2] = columnTo + 'a';
+    res[3] = rowTo + '1';
+    if (moved != placed)//Promotion
+        res[4] = symbolA(toGenericPiece(placed));
+    return moveNotation(res.data());
+}
+
+class alignas(8) GameState {//152 bytes, the board and all side state in one block. The mailbox is read as 8-byte words by the hasher.
+    //Piece* board[64];
+public:
+    std::array<Piece, mailboxSize> mailbox;//Indexed by toMailbox, the sentinels are Piece::OffBoard. Written only through setPiece.
+    int16_t repeatableMoves;
+    PlayerSide playerOnMove;
+    uint8_t castling;//Bit rookSide * 2 + index(player) is set while that castling is still possible
+    int32_t psqtScore;//Packed (packScore) material and square values of all pieces, from white's point of view
+    uint8_t gamePhase;//Sum of phaseWeight of all pieces, phaseMidgame at the start
+    std::array<u64, 2> pieceSquares;//Squares occupied by each side (bits of the 8x8 board indices), indexed by index(side)
+
+    //rookSide 0 is the queen side (column a), 1 the king side (column h)
+    static constexpr uint8_t castleBit(i8 rookSide, PlayerSide player) noexcept
+    {
+        return uint8_t(1u << (rookSide * 2 + index(player)));
+    }
+    static constexpr uint8_t castleBits(PlayerSide player) noexcept
+    {
+        return castleBit(0, player) | castleBit(1, player);
+    }
+    constexpr bool canCastle(i8 rookSide, PlayerSide player) const noexcept
+    {
+        return castling & castleBit(rookSide, player);
+    }
+
+    auto operator<=>(const GameState&) const noexcept = default;
+
+    GameState(const GameState& copy) noexcept = default;
+
+    GameState(GameState&& move) noexcept = default;
+
+    GameState& operator=(const GameState& copy) noexcept = default;
+
+    GameState& operator=(GameState&& move) noexcept = default;
+
+    GameState() : GameState(std::array<Piece, 64>{ Piece::Nothing }, 0, PlayerSide::WHITE, 0)
+    {
+    }
+
+    constexpr GameState(const std::array<Piece, 64>& pieces, int16_t repeatableMoves, PlayerSide playerOnMove, uint8_t castling):repeatableMoves(repeatableMoves),playerOnMove(playerOnMove),castling(castling),psqtScore(0),gamePhase(0),pieceSquares{ 0, 0 }
+    {
+        mailbox.fill(Piece::OffBoard);
+        for (i8 i = 0; i < 64; ++i)
+            mailbox[boardSquares[i]] = Piece::Nothing;
+        for (i8 i = 0; i < 64; ++i)
+            setPiece(boardSquares[i], pieces[i]);
+    }
+
+    constexpr u64 pieces(PlayerSide side) const noexcept
+    {
+        return pieceSquares[index(side)];
+    }
+
+    //Every write to the board goes through here, so that the square sets and the evaluation stay in sync with the mailbox
+    constexpr void setPiece(i8 square, Piece p) noexcept
+    {
+        AssertAssume(mailboxToIndex[square] >= 0);
+        const Piece old = mailbox[square];
+        psqtScore += pieceSquareScore(p, square) - pieceSquareScore(old, square);
+        gamePhase += piecePhaseWeight(p) - piecePhaseWeight(old);
+
+        const u64 bit = u64(1) << mailboxToIndex[square];
+        pieceSquares[0] &= ~bit;
+        pieceSquares[1] &= ~bit;
+        if (p != Piece::Nothing)
+            pieceSquares[index(pieceColor(p))] |= bit;
+        mailbox[square] = p;
+    }
+
+    //The 8x8 board, a1 to h8
+    constexpr std::array<Piece, 64> board() const
+    {
+        std::array<Piece, 64> res;
+        for (i8 i = 0; i < 64; ++i)
+            res[i] = mailbox[boardSquares[i]];
+        return res;
+    }
+
+    //Tapered evaluation from white's point of view
+    constexpr Score evaluate() const noexcept
+    {
+        return taperedScore(mgScore(psqtScore), egScore(psqtScore), gamePhase);
+    }
+
+    //Evaluation after the piece is placed on the square, without changing the board
+    constexpr Score evaluateWith(i8 square, Piece p) const noexcept
+    {
+        const Piece old = mailbox[square];
+        const int32_t score = psqtScore + pieceSquareScore(p, square) - pieceSquareScore(old, square);
+        return taperedScore(mgScore(score), egScore(score), gamePhase + piecePhaseWeight(p) - piecePhaseWeight(old));
+    }
+
+    constexpr std::array<char, 128> piecesCountA() const
+    {
+        std::array<char, 128> res { 0 };
+        for (u64 occupied = pieces(PlayerSide::WHITE) | pieces(PlayerSide::BLACK); occupied; occupied &= occupied - 1)
+            ++res[symbolA(mailbox[boardSquares[std::countr_zero(occupied)]])];
+        return res;
+    }
+
+    constexpr Score priceInLocation(i8 square, PlayerSide playerColor) const
+    {
+        auto piece = mailbox[square];
+
+        AssertAssume(playerColor == PlayerSide::BLACK || playerColor == PlayerSide::WHITE);
+
+        if (piece == Piece::Nothing)
+            return 0;
+        else if (piece == Piece::OffBoard)
+            return -scoreInfinite;
+        else
+            return pricePiece(piece) * pieceColor(piece) * (-playerColor);
+    }
+
+    constexpr const Piece& pieceAt(i8 column, i8 row) const
+    {
+        AssertAssume (!(column < 0 || column > 7 || row < 0 || row > 7));
+        return mailbox[toMailbox(column, row)];
+    }
+    constexpr void setPieceAt(i8 column, i8 row, Piece p)
+    {
+        AssertAssume(!(column < 0 || column > 7 || row < 0 || row > 7));
+        setPiece(toMailbox(column, row), p);
+    }
+
+    constexpr const Piece& pieceAt(char column, char row) const
+    {
+        if (column < 'a' || column>'h' || row < '1' || row>'8')
+            throw std::exception("Invalid coordinates");
+        else
+            return pieceAt((i8)(column - 'a'), (i8)(row - '1'));
+    }
+    constexpr void setPieceAt(char column, char row, Piece p)
+    {
+        if (column < 'a' || column>'h' || row < '1' || row>'8')
+            throw std::exception("Invalid coordinates");
+        else
+            setPieceAt((i8)(column - 'a'), (i8)(row - '1'), p);
+    }
+
+    constexpr void movePiece(char columnFrom, char rowFrom, char columnTo, char rowTo)
+    {
+        const Piece from = pieceAt(columnFrom, rowFrom);
+
+        if (from == Piece::Nothing)
+            debugOut << "ERROR! Moving an empty field!" << std::endl;
+            //throw std::exception("Trying to move an empty field");
+
+        setPieceAt(columnTo, rowTo, from);
+        setPieceAt(columnFrom, rowFrom, Piece::Nothing);
+    }
+
+    void print(PlayerSide pov = PlayerSide::WHITE) const
+    {
+        return print(out, pov);
+    }
+
+    template <class T>
+    void print(T& os, PlayerSide pov = PlayerSide::WHITE) const
+    {
+        static_assert(std::is_base_of<std::ios_base, T>::value, "Must be an output stream");
+        switch (pov)
+        {
+        case PlayerSide::BLACK:
+        {
+            for (i8 i = 0; i < 8; ++i) {
+                os << i + 1 << ' ';
+                for (i8 j = 7; j >= 0; --j) {
+                    os << '|';
+
+                    printPiece(pieceAt(j, i), os);
+                }
+                os << '|' << nl;
+            }
+            os << "   h g f e d c b a";
+        } break;
+        case PlayerSide::WHITE:
+        {
+            for (i8 i = 7; i >= 0; --i) {
+                os << i + 1 << ' ';
+                for (i8 j = 0; j < 8; ++j) {
+                    os << '|';
+                    //wcout<<((((j+i*8)%2)==0)?"\033[40m":"\033[43m");
+                    printPiece(pieceAt(j, i), os);
+                }
+                os << '|' << nl;
+            }
+            os << "   a b c d e f g h";
+        } break;
+        default:
+            std::unreachable();
+        }
+
+        os << nl << std::flush;
+    }
+
+
+    moveNotation findDiff(const GameState& old) const
+    {
+        std::array<char, 6> res = { 0 };
+
+        Piece oldPiece = Piece::Nothing;
+        const auto squares = board();
+        const auto oldSquares = old.board();
+
+        for (size_t i = 0; i < squares.size(); ++i)
+        {
+            if (squares[i] == Piece::Nothing && oldSquares[i] != Piece::Nothing)
+            {
+                oldPiece = oldSquares[i];
+
+                res[0] = i % 8 + 'a';
+                res[1] = i / 8 + '1';
+
+                if(toGenericPiece(oldSquares[i]) == PieceGeneric::King)//castling hack
+                    break;
+            }
+        }
+        if (oldPiece == Piece::Nothing)
+            throw std::exception("No change made");
+        for (size_t i = 0; i < squares.size(); ++i)
+        {
+            if (squares[i] != Piece::Nothing && squares[i] != oldSquares[i])
+            {
+                res[2] = i % 8 + 'a';
+                res[3] = i / 8 + '1';
+
+                if (toGenericPiece(oldPiece) == PieceGeneric::Pawn && (res[3] == '1' || res[3] == '8'))
+                {
+                    res[4] = tolower(symbolA(squares[i]));
+                }
+
+                if (toGenericPiece(squares[i]) == PieceGeneric::King)//castling hack
+                    break;
+            }
+        }
+        return moveNotation(res.data());
+    }
+    
+    //Packed material and square values and the game phase of the whole board computed from scratch, the same as psqtScore and gamePhase
+    std::pair<int32_t, Score> scoreFromScratch() const noexcept
+    {
+#ifdef __AVX2__
+        //One rank of the mailbox per step, its 8 squares are consecutive
+        const __m256i columns = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m128i phaseTable = _mm_load_si128(reinterpret_cast<const __m128i*>(piecePhaseWeights.data()));
+        const int* scoreTable = reinterpret_cast<const int*>(pieceSquareScores.data());
+        __m256i score = _mm256_setzero_si256();
+        __m128i phase = _mm_setzero_si128();
+        for (i8 row = 0; row < 8; ++row)
+        {
+            const i8 first = toMailbox(0, row);
+            const __m128i pieces = _mm_add_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&mailbox[first])), _mm_set1_epi8(6));//Piece + 6, the upper 8 bytes become Nothing
+            phase = _mm_add_epi8(phase, _mm_shuffle_epi8(phaseTable, pieces));
+            const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvtepu8_epi32(pieces), _mm256_set1_epi32(mailboxSize)), _mm256_add_epi32(columns, _mm256_set1_epi32(first)));
+            score = _mm256_add_epi32(score, _mm256_i32gather_epi32(scoreTable, index, 4));
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(score), _mm256_extracti128_si256(score, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return { _mm_cvtsi128_si32(sum), Score(_mm_cvtsi128_si32(_mm_sad_epu8(phase, _mm_setzero_si128()))) };
+#else
+        int32_t score = 0;
+        Score phase = 0;
+        for (u64 occupied = pieces(PlayerSide::WHITE) | pieces(PlayerSide::BLACK); occupied; occupied &= occupied - 1) {
+            const i8 square = boardSquares[std::countr_zero(occupied)];
+            const Piece p = mailbox[square];
+            score += pieceSquareScore(p, square);
+            phase += piecePhaseWeight(p);
+        }
+        return { score, phase };
+#endif
+    }
+
+    //Whether the incrementally kept psqtScore and gamePhase match the board, checked in debug builds
+    bool scoresConsistent() const noexcept
+    {
+        return scoreFromScratch() == std::pair<int32_t, Score>(psqtScore, gamePhase);
+    }
+
+    //Evaluation computed from scratch, evaluate() gives the same from the incremental scores
+    Score balance() const {
+        PROFILE_ZONE(Zone::Eval);
+        const auto [score, phase] = scoreFromScratch();
+        return taperedScore(mgScore(score), egScore(score), phase);
+    }
+
+    
+    constexpr i8 countPiecesMin() const
+    {
+        return std::min(std::popcount(pieceSquares[0]), std::popcount(pieceSquares[1]));
+    }
+
+    constexpr static GameState startingPosition()
+    {
+        return GameState(
+            {
+                Piece::RookWhite, Piece::KnightWhite, Piece::BishopWhite, Piece::QueenWhite, Piece::KingWhite, Piece::BishopWhite, Piece::KnightWhite, Piece::RookWhite,
+                Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite, Piece::PawnWhite,
+                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
+                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
+                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
+                Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing, Piece::Nothing,
+                Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack, Piece::PawnBlack,
+                Piece::RookBlack, Piece::KnightBlack, Piece::BishopBlack, Piece::QueenBlack, Piece::KingBlack, Piece::BishopBlack, Piece::KnightBlack, Piece::RookBlack
+            },
+            0,
+            PlayerSide::WHITE,
+            castleBits(PlayerSide::WHITE) | castleBits(PlayerSide::BLACK)
+        );
+    }
+};
+//The 10x12 mailbox alone is 120 bytes, its border is what spares the move generation the bounds checks. Everything else has to fit into half a cache line.
+static_assert(sizeof(GameState) <= sizeof(std::array<Piece, 120>) + 32, "GameState outgrew its budget next to the mailbox");
+
+
+//Places a piece on a square for the lifetime of the object, like TempSwap, but through GameState::setPiece
+class TempPiece
+{
+    GameState& board;
+    i8 square;
+    Piece backup;
+public:
+    TempPiece(GameState& board, i8 square, Piece p) : board(board), square(square), backup(board.mailbox[square])
+    {
+        board.setPiece(square, p);
+    }
+    ~TempPiece()
+    {
+        board.setPiece(square, backup);
+    }
+};
+
+struct BoardHasher
+{
+    std::size_t operator()(const GameState& s) const noexcept
+    {
+        size_t* toHash = (size_t*)s.mailbox.data();
+        constexpr size_t sizeToHash = mailboxSize / sizeof(size_t);
+
+        size_t res = *toHash;
+        for (size_t i = 1; i < sizeToHash; ++i)
+        {
+            res ^= toHash[i];
+        }
+
+        return res;
+    }
+};
+
+static thread_local stack_vector<std::pair<GameState, Score>, maxMoves> firstPositions;//Each thread may generate moves on its own (perft)
+
+template <bool saveToVector = false>
+struct Variation {
+    //Ordered from the largest members down so that no padding is needed between them, 200 bytes in total
+    GameState board;
+
+    size_t nodes = 0;
+    size_t publishedNodes = 0;//Part of nodes already added to the thread counters
+
+    duration_t time = duration_t(0);
+    Score bestFoundValue;
+
+    bool pruned = false;
+
+    i8 variationDepth;
+
+    PlayerSide firstMoveOnMove;
+    moveNotation firstMoveNotation;
+    moveNotation bestReplyNotation;//Expected answer of the opponent, used for pondering
+
+    //Best placement found for the currently searched piece in the first ply of this variation
+    Piece replyPiece;
+    i8 replySquare;
+
+    //std::unordered_map<GameState, float, BoardHasher> transpositions;
+
+
+    Variation() noexcept = default;
+    Variation(const Variation& copy) noexcept = default;//:researchedBoard(copy.researchedBoard),bestFoundValue(copy.bestFoundValue),pieceTakenValue(copy.pieceTakenValue){}
+    Variation(Variation&& toMove) noexcept = default;// :researchedBoard(move(toMove.researchedBoard)), bestFoundValue(toMove.bestFoundValue), pieceTakenValue(toMove.pieceTakenValue) {}
+
+
+    Variation& operator=(Variation&& toMove) noexcept = default;
+
+    Variation& operator=(const Variation& copy) noexcept = default;
+
+    friend bool operator<(const Variation& l, const Variation& r)
+    {
+        return l.bestFoundValue < r.bestFoundValue;
+    }
+    friend bool operator>(const Variation& l, const Variation& r)
+    {
+        return l.bestFoundValue > r.bestFoundValue;
+    }
+
+    //Variation(GameState researchedBoard, double bestFoundValue, double startingValue):researchedBoard(move(researchedBoard)),bestFoundValue(bestFoundValue), startingValue(startingValue) {}
+    //Variation(GameState board, float startingValue) :board(std::move(board)), bestFoundValue(startingValue), startingValue(startingValue) {}
+    Variation(GameState board, Score bestFoundValue, i8 variationDepth, PlayerSide firstMoveOnMove, moveNotation firstMoveNotation) :board(std::move(board)), bestFoundValue(bestFoundValue), variationDepth(variationDepth), firstMoveOnMove(firstMoveOnMove), firstMoveNotation(firstMoveNotation){}
+
+
+
+
+    bool canTakeKing(PlayerSide onMove)
+    {
+        PROFILE_ZONE(Zone::Legality);
+        Score alpha, beta;
+        alpha = -kingPrice;
+        beta = kingPrice;
+
+        TempSwap playerBackup(board.playerOnMove, onMove);
+        //TempSwap vectorBackup(saveToVector, false);
+
+        Variation<false>* thisHack = reinterpret_cast<Variation<false> *>(this);//TODO prasarna
+
+        TempSwap backupCastling(board.castling, uint8_t(0));
+        SEARCH_STAT(TempSwap movesBackup(movesTried[1], movesTried[1]);)//Its moves are not moves of the node being searched
+
+        for (u64 pieces = board.pieces(onMove); pieces; pieces &= pieces - 1) {
+            const i8 square = boardSquares[std::countr_zero(pieces)];
+            auto foundVal = thisHack->bestMoveWithThisPieceScore(square, 0, alpha, beta);
+
+            if (foundVal * onMove == kingPrice) [[unlikely]]//Je možné vzít krále, hra skončila
+                {
+                    return true;
+                }
+        }
+        return false;
+    }
+
+    //bool canSquareBeTakenBy(i8 column, i8 row, PlayerSide attacker)
+    //{
+    //    i32 totalMoves = 0;
+    //    constexpr float valueSoFar = 0;
+    //    float alpha, beta;
+    //    alpha = -std::numeric_limits<float>::infinity();
+    //    beta = std::numeric_limits<float>::infinity();
+    //    const Piece* backup = pieceAt(column, row);
+    //    //if (backup == nullptr)
+    //    //    return false;
+    //    auto backupPlayer = playerOnMove;
+    //    playerOnMove = attacker;
+    //    
+    //    switch (attacker)
+    //    {
+    //    case WHITE:
+    //        pieceAt(column, row) = &baitBlack;
+    //        break;
+    //    case BLACK:
+    //        pieceAt(column, row) = &baitWhite;
+    //        break;
+    //    default:
+    //        std::unreachable();
+    //    }
+    //    
+    //    for (i8 i = 0; i < board.size(); ++i) {
+    //        const Piece* found = board[i];
+    //        if (found == nullptr)
+    //            continue;
+    //        if (found->pieceColor() == attacker)
+    //        {
+    //            auto foundVal = found->bestMoveWithThisPieceScore(*this, (i % 8), (i / 8), 1, alpha, beta, valueSoFar);
+    //            debugOut << foundVal << std::endl;
+    //            if (foundVal * attacker == baitWhite.pricePiece())//Bait taken
+    //            {
+    //                pieceAt(column, row) = backup;
+    //                playerOnMove = backupPlayer;
+    //                return true;
+    //            }
+    //        }
+    //    }
+    //    pieceAt(column, row) = backup;
+    //    playerOnMove = backupPlayer;
+    //    return false;
+    //}
+
+    bool canMove(PlayerSide onMove)
+    {
+        Score alpha, beta;
+        alpha = -kingPrice;
+        beta = kingPrice;
+
+        for (u64 pieces = board.pieces(onMove); pieces; pieces &= pieces - 1) {
+            const i8 square = boardSquares[std::countr_zero(pieces)];
+            auto foundVal = bestMoveWithThisPieceScore(square, 0, alpha, beta);
+
+            if (foundVal != -scoreInfinite * onMove)
+                return true;
+        }
+        return false;
+    }
+
+    bool isValidSetup()
+    {
+        PROFILE_ZONE(Zone::Legality);
+        //TempSwap saveVectorBackup(saveToVector, false);
+        
+        //bool backup = saveToVector;
+        //saveToVector = false;
+        //Both kings must be on the researchedBoard exactly once
+        auto count = board.piecesCountA();
+        if (count['k'] != 1 || count['K'] != 1)
+            return false;
+
+        //print(debugOut);
+
+        //if (!canMove(opposideSide(playerOnMove)))
+          //  return false;
+        if (canTakeKing(board.playerOnMove))
+            return false;
+
+        //saveToVector = backup;
+
+        //TODO the rest
+        return true;
+    }
+    //double positionScoreHeuristic() {
+    //    double res = 0;
+    //    for (i8 i = 0; i < 64; ++i) {
+    //        if (board[i] != nullptr)
+    //        {
+    //            float alpha, beta;
+    //            alpha = -std::numeric_limits<float>::max();
+    //            beta = std::numeric_limits<float>::max();
+    //            i32 totalMoves = 0;
+    //            double totalValues = 0;
+    //            board[i]->bestMoveWithThisPieceScore(*this, (i % 8), (i / 8), 1, alpha, beta, totalMoves, totalValues, 0,true)
+    //            res += (((double)totalMoves)/2.0) * board[i]->pieceColor();
+    //            if(totalMoves>0)
+    //                res += std::min(std::max(totalValues,-100.0),100.0);
+    //        }
+    //    }
+    //    return res / 10000.0;
+    //}
+
+
+    //Entry points for callers that know the side on move only at runtime, the search itself is instantiated for each side
+    Score bestMoveScore(i8 depth, Score alpha, Score beta)
+    {
+        switch (board.playerOnMove)
+        {
+        case PlayerSide::WHITE:
+            return bestMoveScore<PlayerSide::WHITE>(depth, alpha, beta);
+        case PlayerSide::BLACK:
+            return bestMoveScore<PlayerSide::BLACK>(depth, alpha, beta);
         default:
-            break;
-        }
-    } break;
-    case('a'): {
-        switch (move[1])
-        {
-        case('1'): {
-            board.canCastle[0][index(PlayerSide::WHITE)] = false;//White moves left rook
-        } break;
-        case('8'): {
-            board.canCastle[0][index(PlayerSide::BLACK)] = false;//Black moves left rook
-        } break;
+            std::unreachable();
+        }
+    }
+
+    Score bestMoveWithThisPieceScore(i8 square, i8 depth, Score& alpha, Score& beta)
+    {
+        switch (board.playerOnMove)
+        {
+        case PlayerSide::WHITE:
+            return bestMoveWithThisPieceScore<PlayerSide::WHITE>(square, depth, alpha, beta);
+        case PlayerSide::BLACK:
+            return bestMoveWithThisPieceScore<PlayerSide::BLACK>(square, depth, alpha, beta);
         default:
-            break;
-        }
-    } break;
-    case('h'): {
-        switch (move[1])
-        {
-        case ('1'): {
-            board.canCastle[1][index(PlayerSide::WHITE)] = false;//White moves right rook
-        } break;
-        case ('8'): {
-            board.canCastle[1][index(PlayerSide::BLACK)] = false;//Black moves right rook
-        } break;
-        default:
-            break;
-        }
-    } break;
-
+            std::unreachable();
+        }
+    }
+
+    template <PlayerSide side>
+    Score bestMoveScore(i8 depth, Score alpha, Score beta)
+    {
+        AssertAssume(board.playerOnMove == side);
+
+        //if(depth>3)
+        //{
+        //    auto found = transpositions.find(*this);
+        //    if (found != transpositions.end())
+        //        return found->second;
+        //}
+
+        //{
+        //    debugOut << "Found it" << nl << std::flush;
+        //    print(debugOut);
+        //}
+
+
+        Score bestValue = -scoreInfinite * side;
+
+        if constexpr (!saveToVector)//Generating the root moves is never aborted, uciGo needs them to answer with a move
+        {
+            if (shared.criticalTimeDepleted.load(std::memory_order_relaxed)) [[unlikely]]
+                return bestValue;
+        }
+
+        SEARCH_STAT(
+            ++localStats->search.interiorNodes;
+            localStats->search.seldepth = std::max<size_t>(localStats->search.seldepth, variationDepth - depth + 2);
+            movesTried[depth] = 0;
+        )
+
+        if (depth > depthToStopOrderingPieces) [[unlikely]]
+        {
+            stack_vector<std::pair<Score, i8>, 16> possiblePiecesToMove;
+
+            for (u64 pieces = board.pieces(side); pieces; pieces &= pieces - 1) {
+                Score alphaTmp = alpha;
+                Score betaTmp = beta;
+                const i8 square = boardSquares[std::countr_zero(pieces)];
+                possiblePiecesToMove.unchecked_emplace_back(bestMoveWithThisPieceScore<side>(square, -1, alphaTmp, betaTmp), square);
+            }
+
+            {
+                PROFILE_ZONE(Zone::Ordering);
+                std::sort(possiblePiecesToMove.begin(), possiblePiecesToMove.end(), [](auto& left, auto& right) {return left.first * side > right.first * side; });
+            }
+
+            for (const auto& move : possiblePiecesToMove) {
+                i8 i = move.second;
+                const Piece found = board.mailbox[i];
+                Score foundVal;
+                if (depth > depthToStopOrderingMoves) [[unlikely]]
+                {
+                    foundVal = bestMoveWithThisPieceScoreOrdered<side>(i, depth - 1, alpha, beta);
+                }
+                else
+                {
+                    foundVal = bestMoveWithThisPieceScore<side>(i, depth - 1, alpha, beta);
+                }
+
+                //assert(variationDepth == depthW);
+
+                if (firstLevelPruning && depth == variationDepth) [[unlikely]]
+                {
+                    //std::osyncstream(debugOut) << "alpha: " << alpha << ", beta: " << beta << std::endl;
+                    const Score rootBound = shared.alphaOrBeta.load(std::memory_order_relaxed);
+                    Score& bound = side == PlayerSide::WHITE ? beta : alpha;
+                    if (bound != rootBound)
+                    {
+                        bound = rootBound;
+                        pruned = true;
+                    }
+                    //std::osyncstream(debugOut) << "alpha: " << alpha << ", beta: " << beta << std::endl;
+                }
+
+
+                if (foundVal * side > bestValue * side)
+                {
+                    bestValue = foundVal;
+                    if (depth == variationDepth) [[unlikely]]
+                        bestReplyNotation = toMoveNotation(mailboxColumn(i), mailboxRow(i), mailboxColumn(replySquare), mailboxRow(replySquare), found, replyPiece);
+                }
+                if (foundVal * side == kingPrice)//Je možné vzít krále, hra skončila
+                {
+                    //wcout << endl;
+                    //print();
+                    //break;
+                    return foundVal;//*depth;
+                }
+                if (beta <= alpha && bestValue != -scoreInfinite * side)
+                {
+                    break;
+                    //depthToPieces = 0;
+                }
+            }
+        }
+        else [[likely]]
+        {
+            for (u64 pieces = board.pieces(side); pieces; pieces &= pieces - 1) {
+                const i8 i = boardSquares[std::countr_zero(pieces)];
+                const Piece found = board.mailbox[i];
+
+                auto foundVal = bestMoveWithThisPieceScore<side>(i, depth - 1, alpha, beta);
+
+                if (foundVal * side > bestValue * side) {
+                    bestValue = foundVal;
+                    if (depth == variationDepth) [[unlikely]]
+                        bestReplyNotation = toMoveNotation(mailboxColumn(i), mailboxRow(i), mailboxColumn(replySquare), mailboxRow(replySquare), found, replyPiece);
+                }
+                if (foundVal * side == kingPrice)//Je možné vzít krále, hra skončila
+                {
+                    //wcout << endl;
+                    //print();
+                    //break;
+                    return foundVal;//*depth;
+                }
+                if (beta <= alpha && bestValue != -scoreInfinite * side)
+                {
+                    break;
+                    //depthToPieces = 0;
+                }
+            }
+        }
+
+#ifdef SEARCH_STATS
+        if (beta <= alpha)
+        {
+            ++localStats->search.cutoffs;
+            if (movesTried[depth] == 1)
+                ++localStats->search.firstMoveCutoffs;
+        }
+#endif
+
+        //if (saveToVector) [[unlikely]]
+            //return -std::numeric_limits<float>::max();
+
+
+        if (bestValue == -scoreInfinite * side) [[unlikely]]//Nemůžu udělat žádný legitimní tah (pat nebo mat)
+        {
+            //TempSwap saveToVectorBackup(saveToVector, false);
+
+            if (canTakeKing(oppositeSide(side)))//if (round((bestMoveScore(1, onMove * (-1),valueSoFar, alpha, beta) * playerOnMove * (-1))/100) == kingPrice/100)//Soupeř je v situaci, kdy mi může vzít krále (ohrožuje ho)
+            {
+                bestValue = -(matePrice - (variationDepth - depth + 1)) * side;//Dostanu mat, co nejnižší skóre. Plies from the root, the root move included.
+            }
+            else
+            {//Dostal bych pat, ten je vždycky lepší než dostat mat, ale chci ho docílit jen když prohrávám
+                bestValue = scoreDraw;//When we return 0, stalemate is preffered only if losing (0 is better than negative)
+                //if (valueSoFar * playerOnMove > 0)
+                //{
+                //    //debugOut << "Stalemate not wanted for " << (unsigned)onMove << std::endl;
+                //    bestValue = -stalePrice * playerOnMove;//Vedu, nechci dostat pat
+                //}
+                //else
+                //{
+                //    //debugOut << "Stalemate wanted for "<< (unsigned)onMove << std::endl;
+                //    bestValue = stalePrice * playerOnMove;//Prohrávám, dostat pat beru jako super tah
+                //}  
+            }
+        }
+
+        //if (depth > 3)
+        //    transpositions.emplace(*this, bestValue);
+        return bestValue;
+    }
+
+
+    template <PlayerSide side>
+    auto tryPiece(i8 square, Piece p, i8 depth, Score alpha, Score beta)
+    {
+#ifdef COPY_MAKE
+        const GameState before = board;
+        board.setPiece(square, p);
+        board.playerOnMove = oppositeSide(side);
+        assert(board.scoresConsistent());
+        auto tmp = bestMoveScore<oppositeSide(side)>(depth, alpha, beta);
+        board = before;
+#else
+        TempPiece pieceBackup(board, square, p);
+        board.playerOnMove = oppositeSide(side);
+        assert(board.scoresConsistent());
+        auto tmp = bestMoveScore<oppositeSide(side)>(depth, alpha, beta);
+        board.playerOnMove = side;
+#endif
+        return tmp;
+    }
+
+    //Adds the nodes searched since the last call to this thread's counter and enforces the node limit of the search
+    void publishNodes() noexcept
+    {
+        localStats->addNodes(nodes - publishedNodes);
+        publishedNodes = nodes;
+
+        const size_t limit = shared.nodeLimit.load(std::memory_order_relaxed);
+        if (limit != 0 && searchedNodes() >= limit) [[unlikely]]
+            shared.criticalTimeDepleted.store(true, std::memory_order_relaxed);
+    }
+
+    template <PlayerSide side>
+    void placePieceAt(Piece p, i8 square, i8 depth, Score& alpha, Score& beta, Score& bestValue, Score priceTaken)
+    {
+        if ((++nodes & nodesPublishMask) == 0) [[unlikely]]
+            publishNodes();
+        SEARCH_STAT(++movesTried[depth + 1];)
+        if constexpr (saveToVector)
+        {
+            if (depth == 0)
+            {
+                TempPiece backup(board, square, p);
+                board.playerOnMove = oppositeSide(side);
+                if (isValidSetup())
+                {
+                    //board.print();
+                    Score balance = board.balance();
+                    firstPositions.emplace_back(board, balance);
+                }
+                board.playerOnMove = side;
+                return;
+            }
+        }
+
+
+        //if (doNotContinue) [[unlikely]]
+        //    return;
+
+        if (priceTaken >= kingPrice - 128) [[unlikely]]//Possible to take king (probaly check?)
+        {
+            //doNotContinue = true;
+            bestValue = kingPrice * side;
+            //totalMoves++;
+            //return;
+        }
+        else [[likely]]
+        {
+            Score foundVal;
+            if (depth > 0)
+            {
+                foundVal = tryPiece<side>(square, p, depth, alpha, beta);
+
+                if ((foundVal * side * (-1)) == kingPrice)//V dalším tahu bych přišel o krále, není to legitimní tah
+                    return;
+            }
+            else//leaf node of the search tree
+            {
+                PROFILE_ZONE(Zone::Eval);
+                foundVal = board.evaluateWith(square, p);
+            }
+
+            if (foundVal * side > bestValue * side)
+            {
+                bestValue = foundVal;
+                //First ply of the variation. Legality checks (canTakeKing) pass the same depth, but always search for the other side.
+                if (depth + 1 == variationDepth && side == firstMoveOnMove) [[unlikely]]
+                {
+                    replyPiece = p;
+                    replySquare = square;
+                }
+            }
+        }
+
+        if constexpr (side == PlayerSide::WHITE)
+            alpha = std::max(alpha, bestValue);//bily maximalizuje hodnotu
+        else
+            beta = std::min(beta, bestValue);
+
+        //doNotContinue |= (beta <= alpha);
+    }
+
+
+    template <PlayerSide side, typename F>
+    bool tryPlacingPieceAt(Piece p, i8 square, i8 depth, Score& alpha, Score& beta, Score& bestValue, F condition)
+    {
+        if (beta <= alpha && bestValue != -scoreInfinite * side)
+            return false;
+
+        Score price = board.priceInLocation(square, side);
+
+        if (condition(price, 0))
+        {
+            placePieceAt<side>(p, square, depth, alpha, beta, bestValue, price);
+            return price == 0;
+        }
+        else
+            return false;
+    }
+
+    template <PlayerSide side>
+    auto tryPlacingPieceAt(Piece p, i8 square, i8 depth, Score& alpha, Score& beta, Score& bestValue)
+    {
+        return tryPlacingPieceAt<side>(p, square, depth, alpha, beta, bestValue, MOVE_PIECE_FREE_CAPTURE);
+    }
+
+    template <PlayerSide side, typename T>
+    bool addMoveToList(Piece p, i8 square, Score alpha, Score beta, T& possibleMoves)
+    {
+        Score bestValue = -scoreInfinite * side;
+        bool fieldWasFree = tryPlacingPieceAt<side>(p, square, 0, alpha, beta, bestValue);
+
+        if (bestValue != -scoreInfinite * side)
+            possibleMoves.unchecked_emplace_back(bestValue, square);
+
+        return fieldWasFree;
+    }
+
+    template <PlayerSide side, i8 rookColumn, i8 newRookColumn>
+    void tryCastling(Piece p, i8 row, /*i8 kingColumn, i8 rookColumn, i8 newRookColumn,*/ Score& bestValue, i8 depth, Score& alpha, Score& beta)
+    {
+        AssertAssume(row == 0 || row == 7);
+
+        constexpr i8 kingColumn = 4;
+        constexpr i8 sign = rookColumn < kingColumn ? 1 : -1;
+        constexpr i8 newKingColumn = kingColumn - 2 * sign;
+        /*Castling is permitted only if
+          - neither the king nor the rook has previously moved;
+          - the squares between the king and the rook are vacant;
+          - the king does not leave, cross over, or finish on a square attacked by an enemy piece.
+        */
+
+        for (i8 i = rookColumn + sign; i != kingColumn; i += sign)
+        {
+            if (board.pieceAt(i, row) != Piece::Nothing) [[likely]]//The path is not vacant
+                return;
+        }
+
+        auto pieceInCorner = board.pieceAt(rookColumn, row);
+        if (toGenericPiece(pieceInCorner) != PieceGeneric::Rook)//The piece in the corner is not a rook or is vacant
+            return;
+
+        //assert(variationDepth == depthW);
+
+        if (variationDepth - depth <= castlingMaxDepth) [[unlikely]]//To optimize time, we do not check whether the path is attacked, unless the move is immediate. May produce bad predictions, but only for small number of cases.
+        {
+            for (i8 i = kingColumn; i != newKingColumn; i -= sign)//Do not check the last field (where the king should be placed), it will be checked later anyway
+            {
+                TempPiece fieldSwap(board, toMailbox(i, row), p);
+                if (canTakeKing(oppositeSide(pieceColor(p)))) [[unlikely]]//The path is attacked by enemy
+                {
+                    return;
+                }
+            }
+        }
+
+        //Now we can be sure we can do the castling
+        //Castling is not allowed from this point onwards
+        TempSwap castleBackup(board.castling, uint8_t(board.castling & ~GameState::castleBits(side)));
+
+        //Do the actual piece movement
+        TempPiece rookBackup(board, toMailbox(rookColumn, row), Piece::Nothing);
+        TempPiece newRookBackup(board, toMailbox(newRookColumn, row), pieceInCorner);
+        tryPlacingPieceAt<side>(p, toMailbox(newKingColumn, row), depth - 1, alpha, beta, bestValue);
+        //State will be restored when calling destructors
+    }
+
+    template <PlayerSide side>
+    Score bestMoveWithThisPieceScore(i8 square, i8 depth, Score& alpha, Score& beta)
+    {
+        PROFILE_ZONE(Zone::MoveGen);
+        Score bestValue = -scoreInfinite * side;
+
+        Piece p = board.mailbox[square];
+        PieceGeneric piece = toGenericPiece(p);
+
+        AssertAssume(pieceColor(p) == side);
+
+        board.setPiece(square, Piece::Nothing);
+        //board.playerOnMove = oppositeSide(board.playerOnMove);
+
+        auto tryTarget = [&](i8 target) {
+            return tryPlacingPieceAt<side>(p, target, depth, alpha, beta, bestValue);
+            };
+
+        switch (piece)
+        {
+        case PieceGeneric::Nothing:
+            break;
+        case PieceGeneric::Pawn:
+        {
+            constexpr i8 forward = playerDirection(side) * mailboxWidth;
+            if (mailboxRow(square) + playerDirection(side) == promoteRow(side)) [[unlikely]]
+            {
+                const auto& availableOptions = availablePromotes(p);
+                for (const auto& evolveOption : availableOptions) {
+                    //Capture diagonally
+                    tryPlacingPieceAt<side>(evolveOption, square + forward - 1, depth, alpha, beta, bestValue, MOVE_PIECE_CAPTURE_ONLY);
+                    tryPlacingPieceAt<side>(evolveOption, square + forward + 1, depth, alpha, beta, bestValue, MOVE_PIECE_CAPTURE_ONLY);
+
+                    //Go forward
+                    tryPlacingPieceAt<side>(evolveOption, square + forward, depth, alpha, beta, bestValue, MOVE_PIECE_FREE_ONLY);
+                }
+            }
+            else [[likely]]
+            {
+                //Capture diagonally
+                tryPlacingPieceAt<side>(p, square + forward - 1, depth, alpha, beta, bestValue, MOVE_PIECE_CAPTURE_ONLY);
+                tryPlacingPieceAt<side>(p, square + forward + 1, depth, alpha, beta, bestValue, MOVE_PIECE_CAPTURE_ONLY);
+
+                //Go forward
+
+                //First, try two fields forward (if possible) since it is usually the better option
+                if (mailboxRow(square) == initialRow(p) && board.mailbox[square + forward] == Piece::Nothing)
+                    tryPlacingPieceAt<side>(p, square + forward * 2, depth, alpha, beta, bestValue, MOVE_PIECE_FREE_ONLY);
+
+                //Try one field forward
+                tryPlacingPieceAt<side>(p, square + forward, depth, alpha, beta, bestValue, MOVE_PIECE_FREE_ONLY);
+            }
+
+        } break;
+        case PieceGeneric::Knight:
+        {
+            forEachTarget<PieceGeneric::Knight>(square, tryTarget);
+        } break;
+        case PieceGeneric::Bishop:
+        {
+            forEachTarget<PieceGeneric::Bishop>(square, tryTarget);
+        } break;
+        case PieceGeneric::Rook:
+        {
+            std::optional<TempSwap<uint8_t>> castleBackup;
+
+            const i8 column = mailboxColumn(square);
+            if (initialRow(p) == mailboxRow(square) && column % 7 == 0)
+                castleBackup.emplace(board.castling, uint8_t(board.castling & ~GameState::castleBit(column / 7, side)));
+
+            forEachTarget<PieceGeneric::Rook>(square, tryTarget);
+        } break;
+        case PieceGeneric::Queen:
+        {
+            forEachTarget<PieceGeneric::Queen>(square, tryTarget);
+        } break;
+        case PieceGeneric::King:
+        {
+            const bool canICastleLeft = board.canCastle(0, side);
+            const bool canICastleRight = board.canCastle(1, side);
+
+
+#ifndef CASTLING_DISABLED
+            if (canICastleLeft)//Neither has moved
+            {
+                AssertAssume(square == toMailbox(4, 0) || square == toMailbox(4, 7));//King has to be in initial position
+                tryCastling<side, 0, 3>(p, mailboxRow(square), bestValue, depth + 1, alpha, beta);
+            }
+            if (canICastleRight)//Neither has moved
+            {
+                AssertAssume(square == toMailbox(4, 0) || square == toMailbox(4, 7));//King has to be in initial position
+                tryCastling<side, 7, 5>(p, mailboxRow(square), bestValue, depth + 1, alpha, beta);
+            }
+#endif
+
+            //Classic king movement
+            {
+                TempSwap castleBackup(board.castling, uint8_t(board.castling & ~GameState::castleBits(side)));
+
+                forEachTarget<PieceGeneric::King>(square, tryTarget);
+            }
+        } break;
+        default:
+            std::unreachable();
+        }
+
+        board.setPiece(square, p);
+
+        return bestValue;
+    }
+
+    //float bestMoveWithThisPieceScore<side>(Piece p, GameState& board, i8 column, i8 row, i8 depth, float& alpha, float& beta, float valueSoFar, bool doNotContinue = false)
+    //{
+    //    return bestMoveWithThisPieceScore<side>(toGenericPiece(p), board, column, row, depth, alpha, beta, valueSoFar, doNotContinue);
+    //}
+
+    template <PlayerSide side>
+    Score bestMoveWithThisPieceScoreOrdered(i8 square, i8 depth, Score& alpha, Score& beta)
+    {
+        PROFILE_ZONE(Zone::MoveGen);
+        Piece p = board.mailbox[square];
+
+        std::optional<TempSwap<uint8_t>> castleBackup; // Castling backup (only if moving rooks/king)
+
+        stack_vector<std::pair<Score, i8>, 27> possibleMoves;
+
+        auto addTarget = [&](i8 target) {
+            return addMoveToList<side>(p, target, alpha, beta, possibleMoves);
+            };
+
+        switch (toGenericPiece(p))
+        {
+        case PieceGeneric::Nothing:
+            break;
+        case PieceGeneric::Pawn:
+        {
+            // No need to order/sort pawn movement, there are very few options which can usually be ordered hard-coded.
+            return bestMoveWithThisPieceScore<side>(square, depth, alpha, beta);
+        } break;
+        case PieceGeneric::Knight:
+        {
+            forEachTarget<PieceGeneric::Knight>(square, addTarget);
+        } break;
+        case PieceGeneric::Bishop:
+        {
+            forEachTarget<PieceGeneric::Bishop>(square, addTarget);
+        } break;
+        case PieceGeneric::Rook:
+        {
+            // Back up castling if needed
+            const i8 column = mailboxColumn(square);
+            if (initialRow(p) == mailboxRow(square) && column % 7 == 0)
+                castleBackup.emplace(board.castling, uint8_t(board.castling & ~GameState::castleBit(column / 7, side)));
+
+            forEachTarget<PieceGeneric::Rook>(square, addTarget);
+
+            // Castling will be restored only after the actual tryout, not here
+        } break;
+        case PieceGeneric::Queen:
+        {
+            forEachTarget<PieceGeneric::Queen>(square, addTarget);
+        } break;
+        case PieceGeneric::King:
+        {
+            //TODO make this piece work
+            //Watch out for castling support!
+            return bestMoveWithThisPieceScore<side>(square, depth, alpha, beta);
+        } break;
+        default:
+            std::unreachable();
+        }
+
+        {
+            PROFILE_ZONE(Zone::Ordering);
+            std::sort(possibleMoves.begin(), possibleMoves.end(), [](auto& left, auto& right) {return left.first * side > right.first * side; });
+        }
+
+        TempPiece pieceBackup(board, square, Piece::Nothing);
+        Score bestValue = -scoreInfinite * side;
+
+        for (const auto& i : possibleMoves)
+            tryPlacingPieceAt<side>(p, i.second, depth, alpha, beta, bestValue);
+
+        return bestValue;
+    }
+};
+
+
+
+
+
+//template <typename T>
+//void printGeneralInfo(T& o)
+//{
+//    o << "info depth "<<depthW+1<<" time "<<time
+//}
+template <typename T>
+T& printScore(T& o, Score scoreCp, PlayerSide playerOnMove)
+{
+    o << "score ";
+    if (isMateScore(scoreCp))
+    {//(1 * board.playerOnMove) + 
+        int mateIn = (matePly(scoreCp) + 1) / 2;
+        if ((scoreCp * playerOnMove) < 0)
+            mateIn *= -1;
+        o << "mate " << mateIn;
+        //break; //If mate is inevitable, it makes no sense to continue looking
+    }
+    else
+        o << "cp " << scoreCp * playerOnMove;
+    return o;
+}
+
+void printLowerBound(Score currentLowerBound, i8 depth)
+{
+    std::osyncstream o(out);//May be called from any worker thread
+    o << "info depth " << (unsigned)fullDepth << ' ';
+    if (depth + 1 != fullDepth)
+        o << "seldepth " << (unsigned)depth + 1 << ' ';
+
+    printScore(o, currentLowerBound, oppositeSide(onMoveW));
+    o << ' ';
+    o << "lowerbound";
+    o << nl << std::flush;
+}
+
+//std::atomic<size_t> totalNodesDepth;
+std::optional<duration_t> timeForTheFirst;
+
+auto evaluateGameMove(Variation<> localBoard)//, double alpha = -std::numeric_limits<float>::max(), double beta = std::numeric_limits<float>::max())
+{
+    PROFILE_ZONE(Zone::Search);
+    if (localBoard.variationDepth > 0) [[likely]] //Not predetermined result - e.g. not a draw by repetition
+    {
+        if (isMateScore(localBoard.bestFoundValue)) [[unlikely]]
+        {
+            debugOut << "Encountered board with mate possibility." << std::endl;
+            localBoard.time = duration_t(0); //Known mate, its score counts plies from the root, so it stays comparable with deeper searches
+        }
+        else
+        {
+            auto timeStart = std::chrono::high_resolution_clock::now();
+            //Variation localBoard(board);
+
+            if (!firstLevelPruning)//If we want to know multiple good moves, we cannot prune using a/B at root level
+            {
+                localBoard.bestFoundValue = localBoard.bestMoveScore(localBoard.variationDepth, -scoreInfinite, scoreInfinite);//The window covers the mate scores
+            }
+            else
+            {
+                Score localAlphaBeta = shared.alphaOrBeta.load(std::memory_order_relaxed);
+                if (abs(localAlphaBeta) != scoreInfinite)
+                    localBoard.pruned = true;
+
+                switch (localBoard.board.playerOnMove)
+                {
+                case PlayerSide::BLACK: {
+                    localBoard.bestFoundValue = localBoard.bestMoveScore(localBoard.variationDepth, localAlphaBeta, scoreInfinite);
+                } break;
+                case PlayerSide::WHITE: {
+                    localBoard.bestFoundValue = localBoard.bestMoveScore(localBoard.variationDepth, -scoreInfinite, localAlphaBeta);
+                } break;
+                default:
+                    std::unreachable();
+                }
+            }
+
+            //board.nodes = localBoard.nodes;
+            localBoard.time = std::chrono::high_resolution_clock::now() - timeStart;
+        }
+    }
+    else
+        localBoard.time = duration_t(0); //Known draw by repetition
+
+    switch (localBoard.board.playerOnMove)
+    {
+    case PlayerSide::BLACK: {
+        update_max(shared.alphaOrBeta, localBoard.bestFoundValue);
+    } break;
+    case PlayerSide::WHITE: {
+        update_min(shared.alphaOrBeta, localBoard.bestFoundValue);
+    } break;
+    default:
+        std::unreachable();
+    }
+
+    //totalNodesDepth += localBoard.nodes;
+    return localBoard;
+}
+
+alignas(cacheLineSize) static std::atomic<Variation<>*> bestMove;
+static stack_vector<Variation<>, maxMoves>* q;
+
+void workerFromQ(size_t threadId)//, double alpha = -std::numeric_limits<float>::max(), double beta = std::numeric_limits<float>::max())
+{
+    localStats = &threadStats[threadId];
+    while (true)
+    {
+        if (shared.optimalTimeDepleted.load(std::memory_order_relaxed) || shared.criticalTimeDepleted.load(std::memory_order_relaxed)) [[unlikely]]
+            break;
+        size_t localPos = shared.qPos.fetch_add(1ull, std::memory_order_relaxed);
+        if (localPos >= q->size()) [[unlikely]]//Stopper
+        {
+            shared.qPos.fetch_sub(1ull, std::memory_order_relaxed);
+            break;
+        }
+
+        auto& board = (*q)[localPos];
+        AssertAssume(board.board.playerOnMove == onMoveW);
+        if (options.Verbosity >= 3)//[[likely]]
+        {
+            std::osyncstream(out)
+                << "info "
+                << "currmove "
+                << board.firstMoveNotation << ' '
+                << "currmovenumber "
+                << (localPos + 1)
+                << nl << std::flush;
+        }
+        const auto started = std::chrono::steady_clock::now();
+        auto res = evaluateGameMove(board);//TODO maybe move possible
+        res.publishNodes();
+        traceRootMove(threadId, started, res.firstMoveNotation, res.variationDepth + 1, res.nodes, res.pruned);
+
+        //size_t localSolvedPos = solvedPos.fetch_add(1ull, std::memory_order_relaxed);
+
+        if (!shared.criticalTimeDepleted.load(std::memory_order_relaxed)) [[likely]]
+        {
+            board = std::move(res);
+
+            //Publish the result if it is the best so far. The release makes the board contents visible to whoever acquires the pointer.
+            Variation<>* currentBest = bestMove.load(std::memory_order_acquire);
+            while (currentBest == nullptr || board.bestFoundValue * board.board.playerOnMove < (currentBest->bestFoundValue * board.board.playerOnMove))
+            {
+                if (bestMove.compare_exchange_weak(currentBest, &board, std::memory_order_release, std::memory_order_acquire))
+                {
+                    board.pruned = false;
+
+                    if (options.Verbosity >= 4)
+                        printLowerBound(board.bestFoundValue, board.variationDepth);
+                    break;
+                }
+            }
+        }
+        else
+        {
+            //board.time = std::numeric_limits<duration_t>::infinity();
+            //ALREADY DONE ^
+        }
+        //if (criticalTimeDepleted) [[unlikely]]
+        //    --qPos;
+    }
+}
+
+std::atomic<bool> workToDo = false;
+static void (*poolTask)(size_t threadId) = workerFromQ;//What the workers do when woken up
+std::atomic<bool> threadRestartWanted = false;
+void on_completion() noexcept {
+    workToDo = false;
+}
+std::optional<std::barrier<void(*)() noexcept>> barrier;
+
+//Arrives at the barrier of the pool and accounts the time until the last thread arrives
+void arriveAndWait(size_t threadId)
+{
+    PROFILE_ZONE(Zone::Barrier);
+    auto start = std::chrono::steady_clock::now();
+    barrier->arrive_and_wait();
+    threadStats[threadId].addBarrierWait(std::chrono::steady_clock::now() - start);
+    traceBarrier(threadId, start);
+}
+
+stack_vector<std::thread, maxMoves> threadWorkers;
+
+
+
+void threadWorker(size_t threadId)
+{
+    ThreadPerfScope perf(threadId);
+    while (true)
+    {
+        //debugOut << "thread " << threadId<<" ready for more work" << std::endl;
+        workToDo.wait(false);//Wait until next work is ready
+        //debugOut << "thread " << threadId <<" notified" << std::endl;
+        if (threadRestartWanted) [[unlikely]]//For changing the amount of workers
+            break;
+        poolTask(threadId);//Do the actual work
+        //debugOut << "thread " << threadId << " arrived and waiting" << std::endl;
+        //Signal that this worker is done and wait until all of them are.
+        arriveAndWait(threadId);
+    }
+}
+
+void threadRestart(size_t threadsNewCount)
+{
+    if (!threadWorkers.empty())
+    {
+        threadRestartWanted = true;
+        workToDo = true;
+        workToDo.notify_all();
+
+        for (auto& i : threadWorkers)
+            i.join();
+
+        threadWorkers.clear();
+    }
+
+    workToDo = false;
+    threadRestartWanted = false;
+
+    barrier.emplace(threadsNewCount, on_completion);
+
+    for (size_t i = 1; i < threadsNewCount; ++i)
+        threadWorkers.emplace_back(threadWorker, i);
+}
+
+bool cutoffBadMoves(stack_vector<Variation<>,maxMoves>& boards, Score cutoffPointRelative)
+{
+    Score bestMoveScore = -boards[0].bestFoundValue * boards[0].firstMoveOnMove;
+
+    Score cutoffPoint = bestMoveScore - cutoffPointRelative;
+
+    stack_vector<Variation<>, maxMoves> newBoards;
+
+    size_t cutoffCounter = 0;
+
+    for (size_t i = 1; i < boards.size(); ++i)
+    {
+        if ((-boards[i].bestFoundValue * boards[0].firstMoveOnMove) >= cutoffPoint)
+            newBoards.unchecked_push_back(std::move(boards[i]));
+        else
+            ++cutoffCounter;
+    }
+
+    debugOut << "Cutting off " << cutoffCounter << " bad moves to save time" << std::endl;
+
+    return cutoffCounter != 0;
+}
+
+
+
+
+void printMoveInfo(unsigned depth, const duration_t& elapsedTotal, const duration_t& elapsedDepth, const size_t& nodesDepth, const Variation<>& move, size_t moveRank, PlayerSide pov)
+{
+    const auto secondsPassed = std::chrono::duration_cast<std::chrono::duration<double>>(elapsedDepth);
+    std::osyncstream o(out);//The UCI thread may answer isready at the same time
+    o
+        << "info "
+        << "depth " << (unsigned)fullDepth << ' ';
+#ifdef SEARCH_STATS
+    o << "seldepth " << std::max<size_t>(depth, searchStatsTotal().seldepth) << ' ';
+#else
+    if (depth != fullDepth) [[unlikely]]
+        o << "seldepth " << depth << ' ';
+#endif
+    o
+        << "time "  << (size_t)round(elapsedTotal.count()) << ' '
+        << "nodes " << searchedNodes() << ' '
+        << "nps " << (size_t)round(nodesDepth / secondsPassed.count())<< ' '
+        ;
+    printScore(o, move.bestFoundValue, pov) << ' ';
+    if (move.pruned)
+        o << "upperbound ";
+    o
+        << "multipv " << moveRank << ' '
+        << "pv " << move.firstMoveNotation
+        << nl;
+}
+
+static auto rd = std::random_device{};
+static auto rng = std::default_random_engine{ rd() };
+
+stack_vector<Variation<>,maxMoves> generateMoves(const GameState& board, PlayerSide bestForWhichSide, const stack_vector<std::array<Piece, 64>, 75>& playedPositions)//, i8 depth = 1
+{
+    shared.alphaOrBeta = scoreInfinite * board.playerOnMove;
+    const i8 depth = 1;
+    onMoveW = board.playerOnMove;
+    fullDepth = 1;
+    //depthW = 1;
+    //totalNodesDepth = 0;
+    resetThreadStats();
+    PROFILE_ZONE(Zone::RootGen);
+    //saveToVector = true;
+
+    if (options.Verbosity >= 2)
+        std::osyncstream(out) << "info depth 1" << nl << std::flush;
+    //transpositions.clear();
+    Variation<true> tmp(board, 0, 1, board.playerOnMove, "");
+    //tmp.saveToVector = true;
+
+    firstPositions.clear();
+    tmp.bestMoveScore(1, -scoreInfinite, scoreInfinite);
+    //totalNodesDepth = tmp.nodes;
+    tmp.publishNodes();
+    //transpositions.clear();
+    stack_vector<Variation<>,maxMoves> res;// = std::move(firstPositions);
+    //res.reserve(firstPositions.size());
+
+    //Add move names
+    for (auto& pos : firstPositions)
+    {
+        if (std::find(playedPositions.begin(), playedPositions.end(), pos.first.board()) != playedPositions.end()) [[unlikely]]
+        {
+            res.unchecked_emplace_back(pos.first, 0, 0, pos.first.playerOnMove, pos.first.findDiff(board));
+            debugOut << "Deja vu! Found a possible move that results in an already played position: " << res.back().firstMoveNotation <<". Assigning a value of a draw." << std::endl;
+        }
+        else [[likely]]
+            res.unchecked_emplace_back(pos.first, pos.second, depth, pos.first.playerOnMove, pos.first.findDiff(board));
+        //pos.startingValue *= bestForWhichSide;//To our POV
+        //pos.bestFoundValue *= bestForWhichSide;//To our POV
+        //pos.firstMoveNotation = pos.board.findDiff(board);
+        //pos.variationDepth = depth;
+        //pos.firstMoveOnMove = pos.board.playerOnMove;
+        //pos.movePosition = pos.researchedBoard;
+    }
+    //firstPositions.clear();
+    //if (depth > 1)
+    //{
+    //    auto firstMoves = std::move(res);
+    //    res.clear();
+
+    //    onMoveW = oppositeSide(board.playerOnMove);
+    //    depthW = depth - 1;
+
+
+    //    size_t i = 0;
+    //    for (auto& pos : firstMoves)
+    //    {
+    //        pos.researchedBoard.bestMoveScore(depth - 1, pos.startingValue, -std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    //        for (; i < firstPositions.size(); ++i)
+    //        {
+    //            auto& move = firstPositions[i];
+    //            move.firstMoveNotation = pos.firstMoveNotation;
+    //            move.variationDepth = pos.variationDepth;
+    //            move.firstMoveOnMove = pos.firstMoveOnMove;
+    //            //move.startingValue = pos.startingValue;
+    //            //move.movePosition = pos.movePosition;
+    //        }
+    //    }
+
+    //    res = std::move(firstPositions);
+    //    firstPositions.clear();
+    //}
+
+    //saveToVector = false;
+
+    if (shuffle)
+    {
+        std::shuffle(res.begin(), res.end(), rng);
+    }
+
+    switch (bestForWhichSide)
+    {
+    case PlayerSide::WHITE: {
+        std::sort(res.begin(), res.end(), std::greater<Variation<>>());
+    } break;
+    case PlayerSide::BLACK: {
+        std::sort(res.begin(), res.end(), std::less<Variation<>>());
+    } break;
+    default:
+        std::unreachable();
+    }
+
+    duration_t elapsedTotal = std::chrono::high_resolution_clock::now() - timeGlobalStarted;
+
+    if (options.Verbosity >= 5)
+    {
+        for (size_t i = res.size() - 1; i != 0; --i)
+            printMoveInfo(depth, elapsedTotal, elapsedTotal, tmp.nodes, res[i], i + 1, bestForWhichSide);
+    }
+    if (options.Verbosity >= 1)
+    {
+        printMoveInfo(depth, elapsedTotal, elapsedTotal, tmp.nodes, res[0], 1, bestForWhichSide);
+    }
+
+    std::cout << std::flush;
+
+    return res;
+}
+
+//Perft counts the leaves of the move generator, which is the same one the search uses at the first ply of each variation
+struct PerftEntry
+{
+    std::atomic<u64> key;//Hash xor data, so that a torn write from another thread is detected as a miss
+    std::atomic<u64> data;//Count in the upper 56 bits, depth in the lowest 8
+};
+
+static std::unique_ptr<PerftEntry[]> perftTable;
+static size_t perftTableMask = 0;
+
+void perftTableResize(size_t megabytes)
+{
+    perftTable.reset();
+    perftTableMask = 0;
+    if (megabytes == 0)
+        return;
+
+    size_t entries = 1;
+    while (entries * 2 * sizeof(PerftEntry) <= megabytes * 1024 * 1024)
+        entries *= 2;
+    perftTable = std::make_unique<PerftEntry[]>(entries);
+    perftTableMask = entries - 1;
+}
+
+u64 perftHash(const GameState& board) noexcept
+{
+    u64 res = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < 64; i += 8)
+    {
+        u64 word = 0;
+        for (size_t j = 0; j < 8; ++j)
+            word |= u64((u8)board.mailbox[boardSquares[i + j]]) << (j * 8);
+        res = (res ^ word) * 0xBF58476D1CE4E5B9ull;
+        res ^= res >> 31;
+    }
+    res ^= board.playerOnMove == PlayerSide::WHITE ? 0xD6E8FEB86659FD93ull : 0;
+    res ^= u64(board.castling) * 0x94D049BB133111EBull;
+    return res;
+}
+
+size_t perft(const GameState& board, i8 depth)
+{
+    if (depth == 0)
+        return 1;
+    if (depth > 1 && shared.criticalTimeDepleted.load(std::memory_order_relaxed)) [[unlikely]]//Stopped, perftDivide reports the counts as aborted. Not checked on the last ply, which is most of the calls.
+        return 0;
+
+    u64 hash = 0;
+    if (perftTable && depth > 1)
+    {
+        hash = perftHash(board);
+        const auto& entry = perftTable[hash & perftTableMask];
+        const u64 data = entry.data.load(std::memory_order_relaxed);
+        if ((entry.key.load(std::memory_order_relaxed) ^ data) == hash && (data & 0xFF) == (u64)depth)
+            return data >> 8;
+    }
+
+    Variation<true> generator(board, 0, 1, board.playerOnMove, "");
+    firstPositions.clear();
+    generator.bestMoveScore(1, -scoreInfinite, scoreInfinite);
+
+    size_t res = 0;
+    if (depth == 1)
+        res = firstPositions.size();
+    else
+    {
+        stack_vector<GameState, maxMoves> children;//The recursion overwrites firstPositions
+        for (const auto& i : firstPositions)
+            children.unchecked_push_back(i.first);
+        for (const auto& i : children)
+            res += perft(i, depth - 1);
+    }
+
+    if (perftTable && depth > 1 && !shared.criticalTimeDepleted.load(std::memory_order_relaxed))//A partial count must not be reused
+    {
+        auto& entry = perftTable[hash & perftTableMask];
+        const u64 data = u64(res) << 8 | u64(depth);
+        entry.data.store(data, std::memory_order_relaxed);
+        entry.key.store(hash ^ data, std::memory_order_relaxed);
+    }
+    return res;
+}
+
+struct PerftRoot
+{
+    GameState board;
+    moveNotation move;
+    size_t nodes = 0;
+};
+
+static stack_vector<PerftRoot, maxMoves>* perftQ;
+static i8 perftDepth;
+static std::atomic<size_t> perftPos;
+
+void perftWorker(size_t)
+{
+    while (true)
+    {
+        size_t localPos = perftPos.fetch_add(1, std::memory_order_relaxed);
+        if (localPos >= perftQ->size())
+            break;
+        auto& root = (*perftQ)[localPos];
+        root.nodes = perft(root.board, perftDepth - 1);
+    }
+}
+
+//Prints the leaf count below every root move. The root moves are split among the thread pool, if there is one.
+size_t perftDivide(const GameState& board, i8 depth, std::ostream& o)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    stack_vector<PerftRoot, maxMoves> roots;
+    if (depth > 0)
+    {
+        Variation<true> generator(board, 0, 1, board.playerOnMove, "");
+        firstPositions.clear();
+        generator.bestMoveScore(1, -scoreInfinite, scoreInfinite);
+        for (const auto& i : firstPositions)
+            roots.unchecked_push_back({ i.first, i.first.findDiff(board), 1 });
+    }
+
+    if (depth > 1)
+    {
+        perftQ = &roots;
+        perftDepth = depth;
+        perftPos = 0;
+
+        if (barrier && !threadWorkers.empty())
+        {
+            poolTask = perftWorker;
+            workToDo = true;
+            workToDo.notify_all();
+            perftWorker(0);
+            arriveAndWait(0);
+            poolTask = workerFromQ;
+        }
+        else
+            perftWorker(0);
+    }
+
+    std::osyncstream os(o);
+    if (shared.criticalTimeDepleted.load(std::memory_order_relaxed))
+    {
+        os << nl << "Perft aborted, the counts are incomplete" << nl << std::flush;
+        return 0;
+    }
+
+    size_t total = 0;
+    for (const auto& i : roots)
+    {
+        os << i.move << ": " << i.nodes << nl;
+        total += i.nodes;
+    }
+    if (depth == 0)
+        total = 1;
+
+    const duration_t elapsed = std::chrono::steady_clock::now() - start;
+    os << nl << "Nodes searched: " << total << nl
+        << "Time: " << (size_t)round(elapsed.count()) << " ms" << nl
+        << "Nodes/second: " << (size_t)round(total / (elapsed.count() / 1000)) << nl << std::flush;
+    return total;
+}
+
+duration_t findBestOnSameLevel(stack_vector<Variation<>, maxMoves>& boards, i8 depth)//, PlayerSide onMove)
+{
+    AssertAssume(!boards.empty());
+    PlayerSide onMoveResearched = boards.front().board.playerOnMove;
+    depth -= 1;// boards.front().variationDepth;
+    size_t totalNodesDepth = 0;
+    duration_t timeFirstBoard(0);
+    //i8 previousDepth = std::numeric_limits<i8>::max();
+
+    for (auto& i : boards)
+    {
+        AssertAssume(i.board.playerOnMove == onMoveResearched);//Check if all boards are from the same POV. Required for the a/B to work.
+
+        if (i.variationDepth != 0) [[likely]]//If not draw by repetition
+            {
+                //previousDepth = std::min(previousDepth,i.variationDepth);
+                i.variationDepth = depth;
+            }
+
+        i.time = static_cast<duration_t>(std::numeric_limits<double>::infinity()); //To know which failed to finish
+        i.pruned = false;
+        i.nodes = 0;
+        i.publishedNodes = 0;
+    }
+
+    const size_t nodesBefore = searchedNodes();
+
+
+    auto timeThisStarted = std::chrono::high_resolution_clock::now();
+    if (depth > 0)
+    {
+        shared.alphaOrBeta = scoreInfinite * onMoveResearched;
+        //lastReportedLowerBound = alphaOrBeta;
+        //transpositions.clear();
+
+        onMoveW = onMoveResearched;
+        //depthW = depth;
+        //q.clear();
+
+        auto oldBestMove = boards[0].firstMoveNotation;
+
+        bestMove = nullptr;
+        q = &boards;
+        shared.qPos = 0;
+
+
+        //solvedMoves = &resultBoards;
+
+
+
+        //q.reserve(boards.size());
+        //for (auto& board : boards)
+        //    q.push_back(&board);
+
+        //if(options.MultiPV<=1)
+        //    evaluateGameMoveFromQ(qPos++, depthW);//It is usefull to run first pass on single core at full speed to set up alpha/Beta
+
+
+        workToDo = true;
+        workToDo.notify_all();
+
+
+        workerFromQ(0);//Do work on this thread
+
+        arriveAndWait(0);//Wait for the workers to finish
+
+
+        stack_vector<Variation<>, maxMoves> resultBoards;
+
+        Variation<>* const bestFound = bestMove.load(std::memory_order_relaxed);//The barrier already synchronized with the workers
+
+        //Add the best result
+        if (bestFound != nullptr)
+        {
+            resultBoards.unchecked_push_back(*bestFound);
+        }
+
+        //Add the rest of the boards that finished computation without changing the order
+        for (auto&& i : boards)
+        {
+            if (&i != bestFound && i.time != static_cast<duration_t>(std::numeric_limits<double>::infinity()))
+                resultBoards.unchecked_push_back(std::move(i));
+            //else
+              //  debugOut << "board " << i.firstMoveNotation << " has value of infinity" << std::endl;
+        }
+
+        if (resultBoards.size() == availableMoves)
+        {
+            fullDepth = depth + 1;
+        }
+        if (resultBoards.size() != boards.size())
+        {
+            debugOut << "Not enough time to search all moves. Only managed to fully go through " << resultBoards.size() << " out of " << boards.size() << std::endl;
+
+            for (const auto& i : resultBoards)
+            {
+                if (oldBestMove == i.firstMoveNotation)
+                {
+                    debugOut << "Time ran out, but the engine at least managed to include the supposed best move in the results. Returning results." << std::endl;
+                    goto bestMoveFound;
+                }
+            }
+            debugOut << "Time ran out and the engine did not manage to include the suppossed best move. Cancelling the results." << std::endl;
+            return duration_t(std::numeric_limits<double>::infinity());
+
+        }
+    bestMoveFound:
+
+        //Determine if pruning caused some upperbound results (we cannot calculate with them the same way)
+        bool noUpperboundResults = true;
+        for (const auto& i : resultBoards)
+        {
+            if (i.pruned)
+            {
+                noUpperboundResults = false;
+                break;
+            }
+        }
+
+        if (noUpperboundResults)
+            debugOut << "All board evaluations are exact, performing sorting/shuffling!" << std::endl;
+        else
+            debugOut << "Some board evalutions are upper bound only, sorting/shuffling not possible." << std::endl;
+
+
+        //Shuffle best results if required and best result is not a draw
+        if (noUpperboundResults && resultBoards.size() > 2)
+        {
+            if (shuffle && bestFound->bestFoundValue != 0)
+            {
+                std::shuffle(resultBoards.begin(), resultBoards.end(), rng);
+            }
+
+            //Sort only if we know the real value of all boards (no first level pruning occured)
+            PROFILE_ZONE(Zone::Ordering);
+            switch (onMoveResearched)
+            {
+            case PlayerSide::WHITE: {
+                std::stable_sort(resultBoards.begin(), resultBoards.end(), std::less<Variation<>>());
+            } break;
+            case PlayerSide::BLACK: {
+                std::stable_sort(resultBoards.begin(), resultBoards.end(), std::greater<Variation<>>());
+            } break;
+            default:
+                std::unreachable();
+            }
+        }
+
+        totalNodesDepth = searchedNodes() - nodesBefore;
+
+        for (size_t i = 0; i < resultBoards.size() && timeFirstBoard.count() == 0; ++i)
+            timeFirstBoard = resultBoards[i].time;
+
+        if (timeFirstBoard.count() == 0) [[unlikely]] //All are 0 - all moves lead to a draw by repetition. No need to search further
+            timeFirstBoard = duration_t(std::numeric_limits<double>::infinity());
+
+        boards = std::move(resultBoards);
+    }
+    duration_t elapsedThis = std::chrono::high_resolution_clock::now() - timeThisStarted;
+    duration_t elapsedTotal = std::chrono::high_resolution_clock::now() - timeGlobalStarted;
+
+    if (options.Verbosity >= 6 || options.MultiPV > 1)
+    {
+        for (size_t i = boards.size() - 1; i != 0; --i)
+            printMoveInfo(depth + 1, elapsedTotal, elapsedThis, totalNodesDepth, boards[i], i + 1, oppositeSide(onMoveW));
+    }
+
+    if (options.Verbosity >= 1) //TODO: make it available to print later for the last depth if verbosity is set to 1, do not print every time unless >= 2.
+    {
+        printMoveInfo(depth + 1, elapsedTotal, elapsedThis, totalNodesDepth, boards.front(), 1, oppositeSide(onMoveW));
+        std::cout << std::flush;
+    }
+
+    return timeFirstBoard;
+}
+
+//std::pair<GameState, float> findBestOnTopLevel(GameState& board, i8 depth, PlayerSide onMove)
+//{
+//    auto tmp = generateMoves(board, onMove);//, onMove);
+//    findBestOnSameLevel(tmp, depth - 1);//, oppositeSide(onMove));
+//    const auto& res = tmp.front();
+//    return { res.board, res.bestFoundValue };
+//}
+
+
+
+std::string_view getWord(std::string_view& str)
+{
+    size_t i = 0;
+    for (; i < str.size(); ++i)
+    {
+        if (isspace(str[i]))
+            break;
+    }
+    auto res = str.substr(0, i);
+    if (i >= str.size())
+        str = "";
+    else
+        str = str.substr(i + 1);
+    return res;
+}
+
+//The whole word as a decimal number, nothing if it is not one
+std::optional<long long> parseNumber(std::string_view word)
+{
+    long long value;
+    const auto [end, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+    if (word.empty() || error != std::errc() || end != word.data() + word.size())
+        return std::nullopt;
+    return value;
+}
+
+void executeMove(GameState& board, std::string_view& str, stack_vector<std::array<Piece, 64>,75>& playedPositionsWhite, stack_vector<std::array<Piece, 64>, 75>& playedPositionsBlack)
+{
+    auto move = getWord(str);
+
+    auto backup = board.pieceAt(move[2], move[3]);
+    if (backup == Piece::Nothing && toGenericPiece(board.pieceAt(move[0], move[1])) != PieceGeneric::Pawn)
+    {
+        board.repeatableMoves += 1;
+
+        if (board.playerOnMove == PlayerSide::WHITE)
+            playedPositionsWhite.push_back(board.board());
+        else
+            playedPositionsBlack.push_back(board.board());
+    }
+    else
+    {
+        board.repeatableMoves = 0;
+        playedPositionsWhite.clear();
+        playedPositionsBlack.clear();
+    }
+
+    board.movePiece(move[0], move[1], move[2], move[3]);
+
+    //Castling
+    if      (move == "e1c1" && board.pieceAt(move[2], move[3]) == Piece::KingWhite)
+        board.movePiece('a', '1', 'd', '1');
+    else if (move == "e1g1" && board.pieceAt(move[2], move[3]) == Piece::KingWhite)
+        board.movePiece('h', '1', 'f', '1');
+    else if (move == "e8c8" && board.pieceAt(move[2], move[3]) == Piece::KingBlack)
+        board.movePiece('a', '8', 'd', '8');
+    else if (move == "e8g8" && board.pieceAt(move[2], move[3]) == Piece::KingBlack)
+        board.movePiece('h', '8', 'f', '8');
+
+    //Pawn promotion
+    else if (move.size() == 5)
+    {
+        char promotionChar = tolower(move[4]);
+        Piece evolvedInto = fromGenericPiece(fromGenericSymbol(promotionChar), board.playerOnMove);
+        board.setPieceAt(move[2], move[3], evolvedInto);
+    }
+
+    //En passant
+    else if (move[1] == '5' && board.pieceAt(move[2], move[3]) == Piece::PawnWhite && move[0] != move[2] && backup == Piece::Nothing)
+    {
+        board.setPieceAt(move[2], move[3] - 1, Piece::Nothing);
+    }
+    else if (move[1] == '4' && board.pieceAt(move[2], move[3]) == Piece::PawnBlack && move[0] != move[2] && backup == Piece::Nothing)
+    {
+        board.setPieceAt(move[2], move[3] + 1, Piece::Nothing);
+    }
+
+    //Castling posibility invalidation
+    //Doesn't matter when later in the game the piece no longer stands in original position -> it must have left before
+    switch (move[0])
+    {
+    case('e'): {
+        switch (move[1])
+        {
+        case('1'):
+        {
+            //White moves king
+            board.castling &= ~GameState::castleBits(PlayerSide::WHITE);
+        } break;
+        case('8'):
+        {
+            //Black moves king
+            board.castling &= ~GameState::castleBits(PlayerSide::BLACK);
+        } break;
+        default:
+            break;
+        }
+    } break;
+    case('a'): {
+        switch (move[1])
+        {
+        case('1'): {
+            board.castling &= ~GameState::castleBit(0, PlayerSide::WHITE);//White moves left rook
+        } break;
+        case('8'): {
+            board.castling &= ~GameState::castleBit(0, PlayerSide::BLACK);//Black moves left rook
+        } break;
+        default:
+            break;
+        }
+    } break;
+    case('h'): {
+        switch (move[1])
+        {
+        case ('1'): {
+            board.castling &= ~GameState::castleBit(1, PlayerSide::WHITE);//White moves right rook
+        } break;
+        case ('8'): {
+            board.castling &= ~GameState::castleBit(1, PlayerSide::BLACK);//Black moves right rook
+        } break;
+        default:
+            break;
+        }
+    } break;
+
+    default:
+        break;
+    }
+
+    board.playerOnMove = oppositeSide(board.playerOnMove);
+}
+
+void parseMoves(GameState& board, std::string_view str, stack_vector<std::array<Piece, 64>, 75>& playedPositions)
+{
+    if (getWord(str) != "moves")
+        return;
+
+    stack_vector<std::array<Piece, 64>, 75> playedPositionsWhite;
+    stack_vector<std::array<Piece, 64>, 75> playedPositionsBlack;
+
+    while (!str.empty())
+    {
+        executeMove(board, str, playedPositionsWhite, playedPositionsBlack);
+    }
+
+    if (board.playerOnMove == PlayerSide::WHITE)
+        playedPositions = std::move(playedPositionsBlack);
+    else
+        playedPositions = std::move(playedPositionsWhite);
+}
+
+GameState posFromFen(std::string_view& fen)
+{
+    GameState res;
+
+    size_t i = 0;
+    // Position
+    {
+        size_t pos = 64-8;
+        while (fen[i] != ' ')
+        {
+            char c = fen[i++];
+
+            if (c == '/')
+            {
+                assert(pos % 8 == 0); // Invalid fen string
+                pos -= 16;
+            }
+            else if (isdigit(c))
+            {
+                pos += c - '0'; // This many fields are empty
+            }
+            else
+            {
+                assert(pos < 64);
+                res.setPiece(boardSquares[pos++], fromSymbol(c));
+            }
+        }
+        assert(pos == 8);
+    }
+
+    // Space
+    assert(fen[i] == ' ');
+    ++i;
+
+    // Active color
+    switch (fen[i++])
+    {
+    case 'w':
+        res.playerOnMove = PlayerSide::WHITE;
+        break;
+    case 'b':
+        res.playerOnMove = PlayerSide::BLACK;
+        break;
     default:
-        break;
-    }
-
-    board.playerOnMove = oppositeSide(board.playerOnMove);
-}
-
-void parseMoves(GameState& board, std::string_view str, stack_vector<std::array<Piece, 64>, 75>& playedPositions)
-{
-    if (getWord(str) != "moves")
-        return;
-
-    stack_vector<std::array<Piece, 64>, 75> playedPositionsWhite;
-    stack_vector<std::array<Piece, 64>, 75> playedPositionsBlack;
-
-    while (!str.empty())
-    {
-        executeMove(board, str, playedPositionsWhite, playedPositionsBlack);
-    }
-
-    if (board.playerOnMove == PlayerSide::WHITE)
-        playedPositions = std::move(playedPositionsBlack);
-    else
-        playedPositions = std::move(playedPositionsWhite);
-}
-
-GameState posFromFen(std::string_view& fen)
-{
-    GameState res;
-
-    size_t i = 0;
-    // Position
-    {
-        size_t pos = 64-8;
-        while (fen[i] != ' ')
-        {
-            char c = fen[i++];
-
-            if (c == '/')
-            {
-                assert(pos % 8 == 0); // Invalid fen string
-                pos -= 16;
-            }
-            else if (isdigit(c))
-            {
-                pos += c - '0'; // This many fields are empty
-            }
-            else
-            {
-                assert(pos < 64);
-                res.board[pos++] = fromSymbol(c);
-            }
-        }
-        assert(pos == 8);
-    }
-
-    // Space
-    assert(fen[i] == ' ');
-    ++i;
-
-    // Active color
-    switch (fen[i++])
-    {
-    case 'w':
-        res.playerOnMove = PlayerSide::WHITE;
-        break;
-    case 'b':
-        res.playerOnMove = PlayerSide::BLACK;
-        break;
-    default:
-        std::unreachable();
-    }
-
-    // Space
-    assert(fen[i] == ' ');
-    ++i;
-
-    // Castling
-    res.canCastle = { {{false,false},{false,false}} };
-    if (fen[i] != '-')
-    {
-        while (fen[i] != ' ')
-        {
-            switch (fen[i++])
-            {
-            case 'K':
-                res.canCastle[1][1] = true;
-                break;
-            case 'Q':
-                res.canCastle[0][1] = true;
-                break;
-            case 'k':
-                res.canCastle[1][0] = true;
-                break;
-            case 'q':
-                res.canCastle[0][0] = true;
-                break;
-            default:
-                if (options.UCI_Chess960)
-                {
-                    //TODO
-                }
-                else
-                    std::unreachable();
-                break;
-            }
-        }
-    }
-    else
-        ++i;
-    static_assert(index(PlayerSide::BLACK) == 0 && index(PlayerSide::WHITE) == 1); // We are assuming this in the array above
-
-    // Space
-    assert(fen[i] == ' ');
-    ++i;
-
-    // En passant
-    if (fen[i] != '-')
-    {
-        char column = fen[i++];
-        char row = fen[i++];
-
-        // En passant not implemented, TODO
-    }
-    else
-        ++i;
-
-    // Space
-    assert(fen[i] == ' ');
-    ++i;
-
-    // Halfmove clock
-
-    res.repeatableMoves = 0;
-
-    while (fen[i] != ' ')
-    {
-        res.repeatableMoves *= 10;
-        res.repeatableMoves += (fen[i++] - '0');
-    }
-
-    // Space
-    assert(fen[i] == ' ');
-    ++i;
-
-    // Fullmove clock
-
-    i32 fullMoves = 0;
-
-    while (i<fen.size() && fen[i++] != ' ')
-    {
-        fullMoves *= 10;
-        fullMoves += (fen[i] - '0') * 10;
-    }
-
-    fen = fen.substr(i);
-    return res;
-}
-
-GameState posFromString(std::string_view str, stack_vector<std::array<Piece, 64>, 75>& playedPositions)
-{
-    std::optional<GameState> res;
-    auto word = getWord(str);
-    if (word == "startpos") [[likely]]
-    {
-        res.emplace(GameState::startingPosition());
-    }
-    else if (word == "fen")
-    {
-        res.emplace(posFromFen(str));
-
-        //assert(str[0] == ' ');
-        //str = str.substr(1);
-    }
-    else
-        std::unreachable();
-
-    parseMoves(*res, str, playedPositions);
-
-#ifdef _DEBUG
-    res->print(debugOut);
-#endif
-
-    return *res;
-}
-
-Variation<> findBestInNumberOfMoves(GameState& board, i8 moves)
-{
-    timeGlobalStarted = std::chrono::high_resolution_clock::now();
-    //dynamicPositionRanking = false;
-    auto boardList = generateMoves(board, board.playerOnMove, {});
-
-    //for (const auto& i : boardList)
-    //{
-    //    out << i.bestFoundValue << std::endl;
-    //    i.researchedBoard.print();
-    //    out << std::endl;
-    //}
-    //boardList.erase(boardList.begin());
-
-    Variation res;
-    //dynamicPositionRanking = true;
-
-    out << "Depth: ";
-    for (i8 i = 4; i <= moves; i += 2) {
-        auto bestPosFound = findBestOnSameLevel(boardList, i);
-        //dynamicPositionRanking = false;
-        if (criticalTimeDepleted)
-            break;
-        else
-        {
-            res = boardList.front();
-        }
-        out << i << ' ';
-    }
-    out << std::endl;
-
-    return res;
-}
-
-std::mutex uciGoM;
-//bool ponder = false;//TODO finish pondering
-
-duration_t predictMultiSearchTime(duration_t maxSearchTime, size_t nextMoveCount)
-{
-    float threadLoops = ceil(1.0f * nextMoveCount / options.Threads);
-    return maxSearchTime * threadLoops;
-    //return maxSearchTime;
-}
-
-duration_t predictTime(const duration_t& olderTime, const duration_t& newerTime, size_t movesCount)
-{
-    double logOlder = log2(olderTime.count());
-    double logNewer = log2(newerTime.count());
-
-    double growth = logNewer + logNewer - logOlder;
-
-    constexpr double k = 1.0;//extra branching factor
-    growth *= k;
-
-    debugOut << "branching factor is " << growth << std::endl;
-    auto projectedNextTime = predictMultiSearchTime(duration_t(pow(2, growth)), movesCount);
-    debugOut << "Projected next time is " << projectedNextTime.count() << " ms." << std::endl;
-    return projectedNextTime;
-}
-
-constexpr u8 calculatePhaseU8(const GameState& game)
-{
-    constexpr i8 PawnPhase = 0;
-    constexpr i8 KnightPhase = 1;
-    constexpr i8 BishopPhase = 1;
-    constexpr i8 RookPhase = 2;
-    constexpr i8 QueenPhase = 4;
-    constexpr i8 TotalPhase = PawnPhase * 16 + KnightPhase * 4 + BishopPhase * 4 + RookPhase * 4 + QueenPhase * 2;
-
-    const auto counts = game.piecesCountA();
-
-    i8 phase = TotalPhase;
-
-    phase -= counts[symbolA(Piece::PawnWhite)] * PawnPhase;
-    phase -= counts[symbolA(Piece::KnightWhite)] * KnightPhase;
-    phase -= counts[symbolA(Piece::BishopWhite)] * BishopPhase;
-    phase -= counts[symbolA(Piece::RookWhite)] * RookPhase;
-    phase -= counts[symbolA(Piece::QueenWhite)] * QueenPhase;
-
-    phase -= counts[symbolA(Piece::PawnBlack)] * PawnPhase;
-    phase -= counts[symbolA(Piece::KnightBlack)] * KnightPhase;
-    phase -= counts[symbolA(Piece::BishopBlack)] * BishopPhase;
-    phase -= counts[symbolA(Piece::RookBlack)] * RookPhase;
-    phase -= counts[symbolA(Piece::QueenBlack)] * QueenPhase;
-
-    phase = (phase * 255 + (TotalPhase / 2)) / TotalPhase;
-
-    return phase;
-}
-
-constexpr float calculatePhase(const GameState& game)
-{
-    return calculatePhaseU8(game) / 256.0f;
-}
-
-constexpr auto pesto_mg(PieceGeneric p)
-{
-    constexpr std::array<std::array<float, 64>, 7> prices =
-    {{
-        {//case PieceGeneric::Nothing:
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-        },
-        {//case PieceGeneric::Pawn:
-0,   0,   0,   0,   0,   0,  0,   0,
-98, 134,  61,  95,  68, 126, 34, -11,
--6,   7,  26,  31,  65,  56, 25, -20,
--14,  13,   6,  21,  23,  12, 17, -23,
--27,  -2,  -5,  12,  17,   6, 10, -25,
--26,  -4,  -4, -10,   3,   3, 33, -12,
--35,  -1, -20, -23, -15,  24, 38, -22,
-  0,   0,   0,   0,   0,   0,  0,   0,
-        },
-        {//case PieceGeneric::Knight:
--167, -89, -34, -49,  61, -97, -15, -107,
- -73, -41,  72,  36,  23,  62,   7,  -17,
- -47,  60,  37,  65,  84, 129,  73,   44,
-  -9,  17,  19,  53,  37,  69,  18,   22,
- -13,   4,  16,  13,  28,  19,  21,   -8,
- -23,  -9,  12,  10,  19,  17,  25,  -16,
- -29, -53, -12,  -3,  -1,  18, -14,  -19,
--105, -21, -58, -33, -17, -28, -19,  -23,
-        },
-        {//case PieceGeneric::Bishop:
--29,   4, -82, -37, -25, -42,   7,  -8,
--26,  16, -18, -13,  30,  59,  18, -47,
--16,  37,  43,  40,  35,  50,  37,  -2,
- -4,   5,  19,  50,  37,  37,   7,  -2,
- -6,  13,  13,  26,  34,  12,  10,   4,
-  0,  15,  15,  15,  14,  27,  18,  10,
-  4,  15,  16,   0,   7,  21,  33,   1,
--33,  -3, -14, -21, -13, -12, -39, -21,
-        },
-        {//case PieceGeneric::Rook:
-32,  42,  32,  51, 63,  9,  31,  43,
-27,  32,  58,  62, 80, 67,  26,  44,
--5,  19,  26,  36, 17, 45,  61,  16,
--24, -11,   7,  26, 24, 35,  -8, -20,
--36, -26, -12,  -1,  9, -7,   6, -23,
--45, -25, -16, -17,  3,  0,  -5, -33,
--44, -16, -20,  -9, -1, 11,  -6, -71,
--19, -13,   1,  17, 16,  7, -37, -26,
-        },
-        {//case PieceGeneric::Queen:
--28,   0,  29,  12,  59,  44,  43,  45,
--24, -39,  -5,   1, -16,  57,  28,  54,
--13, -17,   7,   8,  29,  56,  47,  57,
--27, -27, -16, -16,  -1,  17,  -2,   1,
- -9, -26,  -9, -10,  -2,  -4,   3,  -3,
--14,   2, -11,  -2,  -5,   2,  14,   5,
--35,  -8,  11,   2,   8,  15,  -3,   1,
- -1, -18,  -9,  10, -15, -25, -31, -50,
-        },
-        {//case PieceGeneric::King:
--65,  23,  16, -15, -56, -34,   2,  13,
- 29,  -1, -20,  -7,  -8,  -4, -38, -29,
- -9,  24,   2, -16, -20,   6,  22, -22,
--17, -20, -12, -27, -30, -25, -14, -36,
--49,  -1, -27, -39, -46, -44, -33, -51,
--14, -14, -22, -46, -44, -30, -15, -27,
-  1,   7,  -8, -64, -43, -16,   9,   8,
--15,  36,  12, -54,   8, -28,  24,  14,
-        }
-    }};
-
-    return prices[(i8)p];
-}
-constexpr auto pesto_eg(PieceGeneric p)
-{
-    constexpr std::array<std::array<float, 64>, 7> prices =
-    { {
-        {//case PieceGeneric::Nothing:
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-0,   0,   0,   0,   0,   0,  0,   0,
-        },
-        {//case PieceGeneric::Pawn:
-      0,   0,   0,   0,   0,   0,   0,   0,
-    178, 173, 158, 134, 147, 132, 165, 187,
-     94, 100,  85,  67,  56,  53,  82,  84,
-     32,  24,  13,   5,  -2,   4,  17,  17,
-     13,   9,  -3,  -7,  -7,  -8,   3,  -1,
-      4,   7,  -6,   1,   0,  -5,  -1,  -8,
-     13,   8,   8,  10,  13,   0,   2,  -7,
-      0,   0,   0,   0,   0,   0,   0,   0,
-        },
-        {//case PieceGeneric::Knight:
-    -58, -38, -13, -28, -31, -27, -63, -99,
-    -25,  -8, -25,  -2,  -9, -25, -24, -52,
-    -24, -20,  10,   9,  -1,  -9, -19, -41,
-    -17,   3,  22,  22,  22,  11,   8, -18,
-    -18,  -6,  16,  25,  16,  17,   4, -18,
-    -23,  -3,  -1,  15,  10,  -3, -20, -22,
-    -42, -20, -10,  -5,  -2, -20, -23, -44,
-    -29, -51, -23, -15, -22, -18, -50, -64,
-        },
-        {//case PieceGeneric::Bishop:
-    -14, -21, -11,  -8, -7,  -9, -17, -24,
-     -8,  -4,   7, -12, -3, -13,  -4, -14,
-      2,  -8,   0,  -1, -2,   6,   0,   4,
-     -3,   9,  12,   9, 14,  10,   3,   2,
-     -6,   3,  13,  19,  7,  10,  -3,  -9,
-    -12,  -3,   8,  10, 13,   3,  -7, -15,
-    -14, -18,  -7,  -1,  4,  -9, -15, -27,
-    -23,  -9, -23,  -5, -9, -16,  -5, -17,
-        },
-        {//case PieceGeneric::Rook:
-    13, 10, 18, 15, 12,  12,   8,   5,
-    11, 13, 13, 11, -3,   3,   8,   3,
-     7,  7,  7,  5,  4,  -3,  -5,  -3,
-     4,  3, 13,  1,  2,   1,  -1,   2,
-     3,  5,  8,  4, -5,  -6,  -8, -11,
-    -4,  0, -5, -1, -7, -12,  -8, -16,
-    -6, -6,  0,  2, -9,  -9, -11,  -3,
-    -9,  2,  3, -1, -5, -13,   4, -20,
-        },
-        {//case PieceGeneric::Queen:
-     -9,  22,  22,  27,  27,  19,  10,  20,
-    -17,  20,  32,  41,  58,  25,  30,   0,
-    -20,   6,   9,  49,  47,  35,  19,   9,
-      3,  22,  24,  45,  57,  40,  57,  36,
-    -18,  28,  19,  47,  31,  34,  39,  23,
-    -16, -27,  15,   6,   9,  17,  10,   5,
-    -22, -23, -30, -16, -16, -23, -36, -32,
-    -33, -28, -22, -43,  -5, -32, -20, -41,
-        },
-        {//case PieceGeneric::King:
-    -74, -35, -18, -18, -11,  15,   4, -17,
-    -12,  17,  14,  17,  17,  38,  23,  11,
-     10,  17,  23,  15,  20,  45,  44,  13,
-     -8,  22,  24,  27,  26,  33,  26,   3,
-    -18,  -4,  21,  24,  27,  23,   9, -11,
-    -19,  -3,  11,  21,  23,  16,   7,  -9,
-    -27, -11,   4,  13,  14,   4,  -5, -17,
-    -53, -34, -21, -11, -28, -14, -24, -43
-        }
-    } };
-
-    return prices[(i8)p];
-}
-
-std::array<std::array<std::array<float, 64>, 7>, 256> pesto;
-std::array<std::array<float, 7>, 256> pieceValues;
-
-void pesto_calculate()
-{
-    for (size_t i = 0; i < 256; i++)//Phases
-    {
-        for (size_t j = 0; j < 7; j++)//Pieces
-        {
-            auto mg = pesto_mg((PieceGeneric)j);
-            auto eg = pesto_eg((PieceGeneric)j);
-            for (size_t k = 0; k < 64; k++)//Board
-            {
-                pesto[i][j][k] = ((mg[k] * (255 - i)) + (eg[k] * i)) / 255;
-            }
-
-            constexpr float mg_value[7] = { 0, 82, 337, 365, 477, 1025,  kingPrice };
-            constexpr float eg_value[7] = { 0, 94, 281, 297, 512,  936,  kingPrice };
-
-            pieceValues[i][j] = ((mg_value[j] * (255 - i)) + (eg_value[j] * i)) / 255;
-        }
-    }
-}
-
-
-void uciGo(GameState& board, std::array<duration_t, 2> playerTime, std::array<duration_t, 2> playerInc, duration_t timeTarget, size_t maxDepth, const stack_vector<std::array<Piece, 64>, 75>& playedPositions)
-{
-    std::unique_lock l(uciGoM);
-    timeGlobalStarted = std::chrono::high_resolution_clock::now();
-    //uciGoM.lock();
-    auto phaseU8 = calculatePhaseU8(board);
-    pestoPhase = &pesto[phaseU8];
-    piecePhase = &pieceValues[phaseU8];
-
-    duration_t timeTargetMax(timeTarget);
-    duration_t timeTargetOptimal(timeTarget);
-
-    if (timeTargetMax == duration_t(0))//We have to calculate our own time
-    {
-        float gamePhase = (17.0f - board.countPiecesMin()) / 16.0f;
-
-        const auto& myTime = playerTime[index(board.playerOnMove)];// == PlayerSide::WHITE ? wtime : btime;
-        const auto& myInc = playerInc[index(board.playerOnMove)];// == PlayerSide::WHITE ? winc : binc;
-
-        timeTargetMax = duration_t(((myTime * gamePhase) / 3));
-        timeTargetOptimal = myInc + timeTargetMax / 3;
-
-        //if (ponder)
-        //{
-        //    debugOut << "We are pondering, enemy time is our time" << std::endl;
-        //    timeTargetMax += playerTime[(oppositeSide(board.playerOnMove) + 1) / 2];
-        //    timeTargetOptimal += playerTime[(oppositeSide(board.playerOnMove) + 1) / 2];
-        //}
-    }
-
-
-    debugOut << "Targeting " << timeTargetOptimal.count() << " ms." << std::endl;
-    debugOut << "Highest I can go is " << timeTargetMax.count() << " ms." << std::endl;
-
-    criticalTimeDepleted = false;
-    optimalTimeDepleted = false;
-    std::mutex mTimeoutCritical;
-    std::mutex mTimeoutOptimal;
-    std::condition_variable cvTimeout;
-    std::atomic<uint8_t> timeoutThreadsWaiting = 0;
-    std::thread criticalTimeout;
-    std::thread optimalTimeout;
-    std::atomic<bool> threadsEndWanted = false;
-
-
-    auto boardList = generateMoves(board,board.playerOnMove, playedPositions);
-    availableMoves = boardList.size();
-
-
-    moveNotation bestPosFound;
-
-    if (boardList.size() == 1) [[unlikely]]//If there is only one possible move to be played, no need to think about anything
-    {
-        debugOut << "Only one move possible, no need to think about anything" << std::endl;
-        bestPosFound = std::move(boardList[0].firstMoveNotation);
-    }
-    else
-    {
-        stack_vector<std::pair<duration_t, moveNotation>, 256> previousResults;
-
-        size_t i = 4;
-
-        if (availableMoves > options.Threads) //Optimization for A/B pruning
-            firstLevelPruning = false; //Depth 4 no pruning
-
-        //Full depth search
-        {
-            //stack_vector<duration_t, 2> previousResultsFullTime;
-            for (; i <= 6; i += 2)
-            {
-                //Loking through everything in a specific depth, no cutoffs, trying to find even unlikely good moves
-
-                //fullDepth = i;
-                if (options.Verbosity >= 2)
-                    out << "info depth " << i << nl << std::flush;
-
-
-                //size_t availableMoveCount = boardList.size();
-
-                uciGoM.unlock();//Allow interruption in the middle of a calculation
-                auto startThisLayer = std::chrono::high_resolution_clock::now();
-                duration_t firstMoveElapsed = findBestOnSameLevel(boardList, i);
-                auto elapsedThisLayer = duration_t(std::chrono::high_resolution_clock::now() - startThisLayer);
-                uciGoM.lock();
-
-
-
-                debugOut << "Elapsed for this layer: " << elapsedThisLayer.count() << std::endl;
-                //previousResultsFullTime.emplace_back(elapsedThisLayer);
-
-                bestPosFound = boardList.front().firstMoveNotation;
-
-
-                previousResults.emplace_back(firstMoveElapsed, boardList.front().firstMoveNotation);
-                debugOut << "Elapsed for the first move: " << firstMoveElapsed.count() << std::endl;
-
-                if (round(abs(boardList.front().bestFoundValue) / matePrice) > 0)
-                {
-                    debugOut << "Mate possibility, no need to search further" << std::endl;
-                    goto returnResult;
-                }
-
-                if (duration_t(std::chrono::high_resolution_clock::now() - timeGlobalStarted) >= timeTargetMax)//Emergency stop if we depleted time
-                {
-                    debugOut << "Time ran out while in the broad depth mode" << std::endl;
-                    goto returnResult;
-                }
-
-
-                if (options.MultiPV == 1)
-                    firstLevelPruning = true;
-                else
-                    firstLevelPruning = false;
-            }
-        }
-
-        timeoutThreadsWaiting = 2;
-
-        if (timeTargetMax != duration_t(std::numeric_limits<double>::infinity()))
-        {
-            criticalTimeout = std::thread([&]()
-                {
-                    std::unique_lock<std::mutex> l(mTimeoutCritical);
-                    while (true)
-                    {
-                        auto res = cvTimeout.wait_for(l, timeTargetMax - duration_t(5));
-                        switch (res)
-                        {
-                        case std::cv_status::no_timeout:[[likely]]
-                            if (threadsEndWanted)[[likely]]
-                                goto end;
-                            break;//spurious wakeup
-                        case std::cv_status::timeout:
-                            criticalTimeDepleted = true;
-                            debugOut << std::endl << std::endl << "Critical timeout! Terminating running computations ASAP" << std::endl << std::endl << std::endl;
-                            goto end;
-                            break;
-                        default:
-                            std::unreachable();
-                        }
-                    }
-                    end:
-                    --timeoutThreadsWaiting;
-                });
-            //threadTimeout.detach();
-        }
-        if (timeTargetOptimal != duration_t(std::numeric_limits<double>::infinity()))
-        {
-            optimalTimeout = std::thread([&]()
-                {
-                    std::unique_lock<std::mutex> l(mTimeoutOptimal);
-                    while (true)
-                    {
-                        auto res = cvTimeout.wait_for(l, timeTargetOptimal);
-                        switch (res)
-                        {
-                        case std::cv_status::no_timeout:[[likely]]
-                            if (threadsEndWanted) [[likely]]
-                                goto end;
-                                break;//spurious wakeup
-                        case std::cv_status::timeout:
-                            optimalTimeDepleted = true;
-                            debugOut << std::endl << std::endl << "Optimal timeout! Not allowing any more variations, but finishing what already started." << std::endl << std::endl << std::endl;
-                            goto end;
-                            break;
-                        default:
-                            std::unreachable();
-                        }
-                    }
-                end:
-                    --timeoutThreadsWaiting;
-                });
-            //threadTimeout.detach();
-        }
-
-
-
-        //Continuing full depth search while in optimal time window
-        {
-            for (; i <= maxDepth; i += 2)
-            {
-                auto projectedNextTime = predictTime(previousResults[previousResults.size() - 2].first, previousResults[previousResults.size() - 1].first, boardList.size());
-
-
-
-                if (projectedNextTime > (timeTargetOptimal - duration_t(std::chrono::high_resolution_clock::now() - timeGlobalStarted)))//.
-                {
-                    debugOut << "It's time to end broad depth mode" << std::endl;
-                    break;
-                }
-                else
-                {
-                    debugOut << "There is plenty of time, continuing the broad depth mode" << std::endl;
-                }
-
-                //Loking through everything in a specific depth, no cutoffs, trying to find even unlikely good moves
-
-                //fullDepth = i;
-                if (options.Verbosity >= 2)
-                    out << "info depth " << i << nl << std::flush;
-
-
-                //size_t availableMoveCount = boardList.size();
-
-                uciGoM.unlock();//Allow interruption in the middle of a calculation
-                //auto startThisLayer = std::chrono::high_resolution_clock::now();
-                duration_t firstMoveElapsed = findBestOnSameLevel(boardList, i);
-                //auto elapsedThisLayer = duration_t(std::chrono::high_resolution_clock::now() - startThisLayer);
-                uciGoM.lock();
-
-                debugOut << "Elapsed for the first move: " << firstMoveElapsed.count() << std::endl;
-
-
-                //previousResults[0] = std::move(previousResults[1]);
-                //previousResults.pop_back();
-                previousResults.emplace_back(firstMoveElapsed, boardList.front().firstMoveNotation);
-
-                //debugOut << "Elapsed for this layer: " << elapsedThisLayer.count() << std::endl;
-                //previousResultsFullTime.emplace_back(elapsedThisLayer);
-
-
-                bestPosFound = boardList.front().firstMoveNotation;
-
-                if (round(abs(boardList.front().bestFoundValue) / matePrice) > 0)
-                {
-                    debugOut << "Mate possibility, no need to search further" << std::endl;
-                    goto returnResult;
-                }
-
-                auto elapsedTotal = duration_t(std::chrono::high_resolution_clock::now() - timeGlobalStarted);
-                if (elapsedTotal >= timeTargetMax)//Emergency stop if we depleted time
-                {
-                    debugOut << "Time ran out while in the broad depth mode" << std::endl;
-                    goto returnResult;
-                }
-            }
-        }
-
-        //previousResults.pop_back();//Next prediction will be from selected moves
-
-        //i += 2;
-
-        debugOut << "Transitioning to selective depth mode" << std::endl;
-
-        //i += 2;
-
-        //Seldepth search
-        {
-            float centiPawnBreakingPoint = 512;
-            for (; i <= maxDepth; i += 2)
-            {
-                bool cutOff = cutoffBadMoves(boardList, centiPawnBreakingPoint);
-
-
-                if (boardList.size() == 1)
-                {
-                    debugOut << "Only one good move after cutoff, no need to search further" << std::endl;
-                    goto returnResult;
-                }
-
-
-
-                //We have enough data to predict next move time
-
-                auto projectedNextTime = predictTime(previousResults[previousResults.size() - 2].first, previousResults[previousResults.size() - 1].first, boardList.size());
-                if (projectedNextTime > (timeTargetMax - duration_t(std::chrono::high_resolution_clock::now() - timeGlobalStarted)))
-                {
-                    debugOut << "We wouldn't get a result in required time" << std::endl;
-                    goto returnResult;
-                }
-                else
-                {
-                    bool foundSameBestMove = previousResults[previousResults.size() - 1].second == previousResults[previousResults.size() - 2].second;
-                    double diff = std::abs(previousResults[previousResults.size() - 1].first.count() - previousResults[previousResults.size() - 2].first.count());
-
-                    if (foundSameBestMove || diff < 50)//The difference is too small, we probably wouldn't get much further info.
-                    {
-                        debugOut << "We could start another depth, but it's probably not necessary." << std::endl;
-                        break;
-                    }
-                    else
-                        debugOut << "This time, we are using some extra time to really think about this move." << std::endl;
-                }
-
-
-                if (options.Verbosity >= 2)
-                {
-                    i8 fullDepthInfo = fullDepth;
-                    if (boardList.size() == availableMoves)
-                        fullDepthInfo += 2;
-
-                    out << "info depth " << (unsigned)fullDepthInfo;
-
-                    if (i != fullDepthInfo)
-                        out << " seldepth " << (unsigned)i;
-
-                    out << nl << std::flush;
-                }
-
-
-                uciGoM.unlock();//Allow interruption in the middle of a calculation
-                duration_t firstMoveElapsed = findBestOnSameLevel(boardList, i);
-                uciGoM.lock();
-
-                bestPosFound = boardList.front().firstMoveNotation;
-
-                if (duration_t(std::chrono::high_resolution_clock::now() - timeGlobalStarted) >= timeTargetMax)//Emergency stop if we depleted time
-                {
-                    debugOut << "Emergency stop!" << std::endl;
-                    goto returnResult;
-                }
-
-                if (round(abs(boardList.front().bestFoundValue) / matePrice) > 0)
-                {
-                    debugOut << "Mate possibility, no need to search further" << std::endl;
-                    goto returnResult;
-                }
-
-
-                previousResults.emplace_back(firstMoveElapsed, boardList.front().firstMoveNotation);
-
-                centiPawnBreakingPoint /= 2;
-            }
-        }
-    }
-
-
-    returnResult:
-    out << "bestmove " << bestPosFound << nl << std::flush;
-
-    if (timeTargetMax != duration_t(std::numeric_limits<double>::infinity()))
-    {
-        threadsEndWanted = true;
-        do
-        {
-            cvTimeout.notify_all();//Cancel the timeout timer
-        } while (timeoutThreadsWaiting != 0);//Have to wait for the threads to be notified, if not started yet
-
-        if(criticalTimeout.joinable())
-            criticalTimeout.join();
-
-        if(optimalTimeout.joinable())
-            optimalTimeout.join();
-    }
-}
-
-
-int uci(std::istream& in, std::ostream& output)
-{
-    pesto_calculate();
-    pestoPhase = &pesto[0]; // Just to set it to something
-    piecePhase = &pieceValues[0];
-    outStream = &output;
-    //while (true)
-    //{
-        //std::string command;
-        //std::cin >> command;
-        //if (command == "isready")
-        //{
-        //    out << "readyok" << std::endl;
-    GameState board;
-    stack_vector<std::array<Piece, 64>, 75> playedPositions;
-    //std::ofstream debugOut("debug.log");
-
-    while (true)
-    {
-        std::string command;
-        std::getline(in, command);
-        
-        if (!in.good()) [[unlikely]]
-        {
-            debugOut << "End of input stream, rude! End the uci session with 'quit' in a controlled way." << std::endl;
-            threadRestart(0);
-            return 0;
-        }
-            
-        std::string_view commandView(command);
-        auto commandFirst = getWord(commandView);
-
-        if (commandFirst == "uci")
-        {
-            {
-                //board = GameState();
-#ifdef _DEBUG
-                options.MultiPV = 1;// maxMoves;
-                options.Threads = 1;
-                options.Verbosity = 7;
-#else
-                options.MultiPV = 1;
-                options.Threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
-                options.Verbosity = 3;
-#endif
-                options.UCI_Chess960 = false;
-            }
-
-            if (threadWorkers.size() != options.Threads)
-                threadRestart(options.Threads);
-
-            out << "id name Klara Destroyer" << nl
-                << "id author Matej Kocourek" << nl
-                << "option name MultiPV type spin min 1 max 218 default " << options.MultiPV << nl
-                << "option name Threads type spin min 1 max 255 default " << options.Threads << nl
-                << "option name Verbosity type spin min 0 max 7 default " << options.Verbosity << nl
-                //<< "option name UCI_Chess960 type check default false" << nl
-                << "uciok" << nl
-                << std::flush;
-        }
-        else if (commandFirst == "ucinewgame")
-        {
-            board = GameState();
-        }
-        else if (commandFirst == "isready")
-        {
-            std::unique_lock l(uciGoM);
-            out << "readyok" << nl << std::flush;
-        }
-        else if (commandFirst == "quit")
-        {
-            threadRestart(0);
-            debugOut << "Bye!" << std::endl;
-            return 0;
-        }
-        else if (commandFirst == "position")
-        {
-            std::unique_lock l(uciGoM);
-            playedPositions.clear();
-            board = posFromString(commandView, playedPositions);
-        }
-        else if (commandFirst == "setoption")
-        {
-            std::unique_lock l(uciGoM);
-            if (getWord(commandView) != "name")
-                continue;
-            auto optionName = getWord(commandView);
-            if (getWord(commandView) != "value")
-                continue;
-            auto optionValue = getWord(commandView);
-            if (optionName == "MultiPV")
-            {
-                //debugOut << "Option value was: " << optionValue << std::endl;
-                options.MultiPV = std::atoll(optionValue.data());
-                debugOut << "Setting MultiPV to " << options.MultiPV << std::endl;
-            }
-            else if (optionName == "Threads")
-            {
-                //debugOut << "Option value was: " << optionValue << std::endl;
-                options.Threads = std::atoll(optionValue.data());
-                debugOut << "Setting Threads to " << options.Threads << std::endl;
-                if (threadWorkers.size() != options.Threads)
-                    threadRestart(options.Threads);
-            }
-            else if (optionName == "Verbosity")
-            {
-                //debugOut << "Option value was: " << optionValue << std::endl;
-                options.Verbosity = std::atoll(optionValue.data());
-                debugOut << "Setting Verbosity to " << options.Verbosity << std::endl;
-            }
-            else if (optionName == "UCI_Chess960")
-            {
-                options.UCI_Chess960 = (optionValue == "true");
-                debugOut << "Setting UCI_Chess960 to " << options.UCI_Chess960 << std::endl;
-            }
-            else
-            {
-                debugOut << "This option is not recognized. Skipping." << std::endl;
-            }
-        }
-        else if (commandFirst == "go")
-        {
-            std::array<duration_t, 2> playerTime = { duration_t(0), duration_t(0) };
-            std::array<duration_t, 2> playerInc = { duration_t(0), duration_t(0) };
-            //int64_t wtime = 0, btime = 0, winc = 0, binc = 0;
-            duration_t timeTarget(0);
-            i8 maxDepth = std::numeric_limits<i8>::max();
-
-            while (true)
-            {
-                auto word = getWord(commandView);
-                if (word.empty())
-                    break;
-                else if (word == "wtime")
-                    playerTime[index(PlayerSide::WHITE)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
-                else if (word == "btime")
-                    playerTime[index(PlayerSide::BLACK)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
-                else if (word == "winc")
-                    playerInc[index(PlayerSide::WHITE)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
-                else if (word == "binc")
-                    playerInc[index(PlayerSide::BLACK)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
-                else if (word == "movetime")
-                {
-                    timeTarget = std::chrono::milliseconds(atoll(getWord(commandView).data()));
-                }
-                else if (word == "infinite")
-                {
-                    timeTarget = duration_t(std::numeric_limits<double>::infinity());
-                }
-                else if (word == "depth")
-                    maxDepth = atoll(getWord(commandView).data());
-            }
-            
-            uciGo(board, playerTime, playerInc, timeTarget, maxDepth, playedPositions);
-        }
-        else
-        {
-            debugOut << "Not recognized command, ignoring: " << commandFirst << std::endl;
-        }
-    }
-    //}
-//}
-}
-
-
-void benchmark(i8 depth, GameState board)
-{
-    board.print();
-    auto start = std::chrono::high_resolution_clock::now();
-    //doneMoves.clear();
-    //auto result = findBestOnTopLevel(researchedBoard,depth,onMove);
-    //auto result = findBestInTimeLimit(researchedBoard, onMove, timeToPlay);
-    auto result = findBestInNumberOfMoves(board, depth);
-    auto end = std::chrono::high_resolution_clock::now();
-
-    //std::string_view move = result.firstMoveNotation.data();
-    //executeMove(board, move);
-    out << result.firstMoveNotation << std::endl;
-
-    out << "cp: " << result.bestFoundValue << std::endl;//<<"Total found score "<<result.second+result.first.balance()<<endl;
-
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0;
-    out << "Done in " << elapsed << "s." << std::endl;
-
-    //board.printW();
-}
-
-}
+        std::unreachable();
+    }
+
+    // Space
+    assert(fen[i] == ' ');
+    ++i;
+
+    // Castling
+    res.castling = 0;
+    if (fen[i] != '-')
+    {
+        while (fen[i] != ' ')
+        {
+            switch (fen[i++])
+            {
+            case 'K':
+                res.castling |= GameState::castleBit(1, PlayerSide::WHITE);
+                break;
+            case 'Q':
+                res.castling |= GameState::castleBit(0, PlayerSide::WHITE);
+                break;
+            case 'k':
+                res.castling |= GameState::castleBit(1, PlayerSide::BLACK);
+                break;
+            case 'q':
+                res.castling |= GameState::castleBit(0, PlayerSide::BLACK);
+                break;
+            default:
+                if (options.UCI_Chess960)
+                {
+                    //TODO
+                }
+                else
+                    std::unreachable();
+                break;
+            }
+        }
+    }
+    else
+        ++i;
+    static_assert(index(PlayerSide::BLACK) == 0 && index(PlayerSide::WHITE) == 1); // We are assuming this in the array above
+
+    // Space
+    assert(fen[i] == ' ');
+    ++i;
+
+    // En passant
+    if (fen[i] != '-')
+    {
+        char column = fen[i++];
+        char row = fen[i++];
+
+        // En passant not implemented, TODO
+    }
+    else
+        ++i;
+
+    // Space
+    assert(fen[i] == ' ');
+    ++i;
+
+    // Halfmove clock
+
+    res.repeatableMoves = 0;
+
+    while (fen[i] != ' ')
+    {
+        res.repeatableMoves *= 10;
+        res.repeatableMoves += (fen[i++] - '0');
+    }
+
+    // Space
+    assert(fen[i] == ' ');
+    ++i;
+
+    // Fullmove clock
+
+    i32 fullMoves = 0;
+
+    while (i<fen.size() && fen[i++] != ' ')
+    {
+        fullMoves *= 10;
+        fullMoves += (fen[i] - '0') * 10;
+    }
+
+    fen = fen.substr(i);
+    return res;
+}
+
+GameState posFromString(std::string_view str, stack_vector<std::array<Piece, 64>, 75>& playedPositions)
+{
+    std::optional<GameState> res;
+    auto word = getWord(str);
+    if (word == "startpos") [[likely]]
+    {
+        res.emplace(GameState::startingPosition());
+    }
+    else if (word == "fen")
+    {
+        res.emplace(posFromFen(str));
+
+        //assert(str[0] == ' ');
+        //str = str.substr(1);
+    }
+    else
+        std::unreachable();
+
+    parseMoves(*res, str, playedPositions);
+
+#ifdef _DEBUG
+    res->print(debugOut);
+#endif
+
+    return *res;
+}
+
+Variation<> findBestInNumberOfMoves(GameState& board, i8 moves)
+{
+    timeGlobalStarted = std::chrono::high_resolution_clock::now();
+    shared.criticalTimeDepleted = false;
+    shared.optimalTimeDepleted = false;
+    shared.nodeLimit = 0;
+    //dynamicPositionRanking = false;
+    auto boardList = generateMoves(board, board.playerOnMove, {});
+
+    //for (const auto& i : boardList)
+    //{
+    //    out << i.bestFoundValue << std::endl;
+    //    i.researchedBoard.print();
+    //    out << std::endl;
+    //}
+    //boardList.erase(boardList.begin());
+
+    Variation res;
+    //dynamicPositionRanking = true;
+
+    out << "Depth: ";
+    for (i8 i = 4; i <= moves; i += 2) {
+        auto bestPosFound = findBestOnSameLevel(boardList, i);
+        //dynamicPositionRanking = false;
+        if (shared.criticalTimeDepleted)
+            break;
+        else
+        {
+            res = boardList.front();
+        }
+        out << i << ' ';
+    }
+    out << std::endl;
+
+    return res;
+}
+
+struct SearchLimits
+{
+    std::array<duration_t, 2> playerTime = { duration_t(0), duration_t(0) };
+    std::array<duration_t, 2> playerInc = { duration_t(0), duration_t(0) };
+    duration_t moveTime = duration_t(0);//0 = calculate our own time from the clock
+    i8 maxDepth = std::numeric_limits<i8>::max();
+    size_t nodes = 0;//0 = no node limit
+    i8 mate = 0;//0 = not looking for a mate, otherwise stop once a mate in this many moves is found
+    bool infinite = false;//Do not report the best move until told to stop
+    bool ponder = false;//Searching on opponent's time, until ponderhit or stop
+};
+
+//What the time manager learns from one finished iteration
+struct IterationSample
+{
+    i8 depth = 0;
+    duration_t elapsed = duration_t(0);//Since our clock started
+    duration_t iterationTime = duration_t(0);
+    moveNotation bestMove;
+    Score score = 0;//From the point of view of the player on move
+    size_t bestMoveNodes = 0;
+    size_t totalNodes = 0;
+    size_t rootMoves = 0;
+};
+
+//Iterations of one search, recorded to replay the time manager offline under other clock settings
+struct SearchTrace
+{
+    std::string fen;
+    float gamePhase = 0;
+    size_t threads = 1;
+    stack_vector<IterationSample, 64> iterations;
+};
+
+static SearchTrace* traceRecorder = nullptr;//When set, uciGo appends every finished iteration
+
+//Splits the budget into a soft limit (no new iteration should end after it) and a hard limit (the search is aborted).
+//The soft limit is rescaled after every iteration: stable best move and a settled score save time, a changing best move,
+//a dropping score or nodes spread over many root moves spend more of it. Does not touch any global state, so traces can be replayed offline.
+class TimeManager
+{
+    duration_t softBase;
+    duration_t hard;
+    duration_t soft;
+    size_t threads;
+    bool fixedTime;//movetime: the whole budget is ours, no scaling
+
+    std::optional<IterationSample> previous;
+    size_t stableIterations = 0;
+
+    static constexpr double minEbf = 2.0;
+    static constexpr double maxEbf = 64.0;
+    static constexpr double maxSoftShare = 0.6;//An iteration aborted by the hard limit is wasted, leave it a margin
+
+    double loops(size_t rootMoves) const
+    {
+        return ceil(1.0 * std::max<size_t>(rootMoves, 1) / threads);
+    }
+
+public:
+    double stabilityFactor = 1;
+    double scoreDropFactor = 1;
+    double nodeFactor = 1;
+    double nodeFraction = 0;
+    Score scoreDrop = 0;
+    double ebf = 8;//Effective branching factor of the last two iterations, per root loop
+    duration_t projectedNextTime = duration_t(0);
+
+    TimeManager(duration_t softLimit, duration_t hardLimit, size_t threadCount, bool fixed) : softBase(std::min(softLimit, hardLimit)), hard(hardLimit), soft(softBase), threads(std::max<size_t>(threadCount, 1)), fixedTime(fixed) {}
+
+    static TimeManager fromClock(duration_t myTime, duration_t myInc, float gamePhase, size_t threadCount)
+    {
+        duration_t hardLimit = (myTime * gamePhase) / 3;
+        return TimeManager(myInc + hardLimit / 3, hardLimit, threadCount, false);
+    }
+
+    static TimeManager fromMoveTime(duration_t moveTime, size_t threadCount)
+    {
+        return TimeManager(moveTime, moveTime, threadCount, true);
+    }
+
+    duration_t softLimit() const { return soft; }
+    duration_t hardLimit() const { return hard; }
+    //When the search is aborted. A few ms are kept for reporting the move, but at most half of a very short budget, so that the broad search gets to search something.
+    duration_t criticalLimit() const { return hard - std::min(duration_t(5), hard / 2); }
+    size_t stable() const { return stableIterations; }
+
+    //Feed a finished iteration
+    void update(const IterationSample& s)
+    {
+        stabilityFactor = 1;
+        scoreDropFactor = 1;
+        scoreDrop = 0;
+        ebf = 8;
+
+        if (previous)
+        {
+            if (previous->bestMove == s.bestMove)
+                ++stableIterations;
+            else
+                stableIterations = 0;
+
+            constexpr std::array<double, 5> stability = { 1.6, 1.15, 0.95, 0.8, 0.65 };
+            stabilityFactor = stability[std::min(stableIterations, stability.size() - 1)];
+
+            scoreDrop = std::clamp<Score>(previous->score - s.score, 0, 200);
+            scoreDropFactor = 1.0 + 0.8 * scoreDrop / 200.0;
+
+            if (previous->iterationTime > duration_t(0))
+                ebf = std::clamp(s.iterationTime / previous->iterationTime * loops(previous->rootMoves) / loops(s.rootMoves), minEbf, maxEbf);
+        }
+
+        nodeFraction = s.totalNodes == 0 ? 0 : 1.0 * s.bestMoveNodes / s.totalNodes;
+        nodeFactor = std::clamp(1.3 - nodeFraction, 0.6, 1.3);//Most of the effort went into refuting the alternatives, so they are close
+
+        if (!fixedTime)
+            soft = std::min(duration_t(softBase * (stabilityFactor * scoreDropFactor * nodeFactor)), hard * maxSoftShare);
+
+        previous = s;
+
+        debugOut << "tm depth=" << (int)s.depth << " elapsed=" << s.elapsed.count() << " iteration=" << s.iterationTime.count()
+            << " best=" << s.bestMove << " stable=" << stableIterations << " score=" << s.score << " drop=" << scoreDrop
+            << " nodes=" << s.totalNodes << " nodeFraction=" << nodeFraction << " roots=" << s.rootMoves << " ebf=" << ebf
+            << " stabilityFactor=" << stabilityFactor << " dropFactor=" << scoreDropFactor << " nodeFactor=" << nodeFactor
+            << " soft=" << soft.count() << " hard=" << hard.count() << std::endl;
+    }
+
+    //Whether another iteration over nextRootMoves is expected to finish before the soft limit
+    bool shouldStart(duration_t elapsed, size_t nextRootMoves)
+    {
+        AssertAssume(previous);
+        projectedNextTime = previous->iterationTime * ebf * loops(nextRootMoves) / loops(previous->rootMoves);
+        const bool startNext = elapsed + projectedNextTime <= soft;
+
+        debugOut << "tm elapsed=" << elapsed.count() << " nextRoots=" << nextRootMoves << " projected=" << projectedNextTime.count()
+            << " soft=" << soft.count() << " decision=" << (startNext ? "continue" : "stop") << std::endl;
+        traceTimeDecision(startNext, projectedNextTime, soft);
+
+        return startNext;
+    }
+};
+
+constexpr u8 calculatePhaseU8(const GameState& game)
+{
+    constexpr i8 PawnPhase = 0;
+    constexpr i8 KnightPhase = 1;
+    constexpr i8 BishopPhase = 1;
+    constexpr i8 RookPhase = 2;
+    constexpr i8 QueenPhase = 4;
+    constexpr i8 TotalPhase = PawnPhase * 16 + KnightPhase * 4 + BishopPhase * 4 + RookPhase * 4 + QueenPhase * 2;
+
+    const auto counts = game.piecesCountA();
+
+    i8 phase = TotalPhase;
+
+    phase -= counts[symbolA(Piece::PawnWhite)] * PawnPhase;
+    phase -= counts[symbolA(Piece::KnightWhite)] * KnightPhase;
+    phase -= counts[symbolA(Piece::BishopWhite)] * BishopPhase;
+    phase -= counts[symbolA(Piece::RookWhite)] * RookPhase;
+    phase -= counts[symbolA(Piece::QueenWhite)] * QueenPhase;
+
+    phase -= counts[symbolA(Piece::PawnBlack)] * PawnPhase;
+    phase -= counts[symbolA(Piece::KnightBlack)] * KnightPhase;
+    phase -= counts[symbolA(Piece::BishopBlack)] * BishopPhase;
+    phase -= counts[symbolA(Piece::RookBlack)] * RookPhase;
+    phase -= counts[symbolA(Piece::QueenBlack)] * QueenPhase;
+
+    phase = (phase * 255 + (TotalPhase / 2)) / TotalPhase;
+
+    return phase;
+}
+
+constexpr float calculatePhase(const GameState& game)
+{
+    return calculatePhaseU8(game) / 256.0f;
+}
+
+//One long-lived timer for all searches. uciGo only arms the deadlines, so no thread has to be created while our clock is running.
+//Optimal (soft) deadline lets the running iteration finish, critical (hard) deadline aborts everything.
+class SearchTimer
+{
+    std::thread thread;
+    std::mutex m;
+    std::condition_variable cv;
+
+    bool endWanted = false;
+    bool armed = false;
+    bool waitForPonderhit = false;
+    std::chrono::steady_clock::time_point origin;
+    std::optional<std::chrono::steady_clock::time_point> optimalDeadline;
+    std::optional<std::chrono::steady_clock::time_point> criticalDeadline;
+    duration_t optimal;
+    duration_t critical;
+
+    void setDeadlines()
+    {
+        optimalDeadline.reset();
+        criticalDeadline.reset();
+        if (optimal != duration_t(std::numeric_limits<double>::infinity()))
+            optimalDeadline = origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(optimal);
+        if (critical != duration_t(std::numeric_limits<double>::infinity()))
+            criticalDeadline = origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(critical);
+    }
+
+    void loop()
+    {
+        std::unique_lock l(m);
+        while (!endWanted)
+        {
+            if (!armed)
+            {
+                cv.wait(l);
+                continue;
+            }
+            if (waitForPonderhit)
+            {
+                if (shared.pondering)//Our clock is not running yet
+                {
+                    cv.wait(l);
+                    continue;
+                }
+                waitForPonderhit = false;
+                if (shared.criticalTimeDepleted)//Stopped while pondering, nothing left to time
+                {
+                    armed = false;
+                    continue;
+                }
+                origin = shared.ponderhitTime;
+                setDeadlines();
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (optimalDeadline && *optimalDeadline <= now)
+            {
+                optimalDeadline.reset();
+                shared.optimalTimeDepleted = true;
+                debugOut << std::endl << std::endl << "Optimal timeout! Not allowing any more variations, but finishing what already started." << std::endl << std::endl << std::endl;
+            }
+            if (criticalDeadline && *criticalDeadline <= now)
+            {
+                criticalDeadline.reset();
+                shared.criticalTimeDepleted = true;
+                debugOut << std::endl << std::endl << "Critical timeout! Terminating running computations ASAP" << std::endl << std::endl << std::endl;
+            }
+
+            if (!optimalDeadline && !criticalDeadline)
+                armed = false;
+            else if (!optimalDeadline)
+                cv.wait_until(l, *criticalDeadline);
+            else if (!criticalDeadline)
+                cv.wait_until(l, *optimalDeadline);
+            else
+                cv.wait_until(l, std::min(*optimalDeadline, *criticalDeadline));
+        }
+    }
+
+public:
+    void start()
+    {
+        endWanted = false;
+        thread = std::thread(&SearchTimer::loop, this);
+    }
+
+    void end()
+    {
+        {
+            std::unique_lock l(m);
+            endWanted = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    //Deadlines are relative to searchStarted, or to the ponderhit if the search is pondering
+    void arm(std::chrono::steady_clock::time_point searchStarted, duration_t optimalTime, duration_t criticalTime, bool ponder)
+    {
+        {
+            std::unique_lock l(m);
+            optimal = optimalTime;
+            critical = criticalTime;
+            origin = searchStarted;
+            waitForPonderhit = ponder;
+            if (!ponder)
+                setDeadlines();
+            armed = true;
+        }
+        cv.notify_all();
+    }
+
+    //The soft limit moves as the time manager learns about the search
+    void setOptimal(duration_t optimalTime)
+    {
+        {
+            std::unique_lock l(m);
+            optimal = optimalTime;
+            if (armed && !waitForPonderhit && !shared.optimalTimeDepleted)
+            {
+                const auto criticalKept = criticalDeadline;
+                setDeadlines();
+                criticalDeadline = criticalKept;
+            }
+        }
+        cv.notify_all();
+    }
+
+    void disarm()
+    {
+        {
+            std::unique_lock l(m);
+            armed = false;
+        }
+        cv.notify_all();
+    }
+
+    //Ponderhit or stop changed the state the timer may be waiting for
+    void notify()
+    {
+        {
+            std::unique_lock l(m);//Do not let the notification slip in between the check and the wait
+        }
+        cv.notify_all();
+    }
+};
+
+static SearchTimer searchTimer;
+
+void uciGo(GameState& board, const SearchLimits& limits, const stack_vector<std::array<Piece, 64>, 75>& playedPositions)
+{
+    timeGlobalStarted = std::chrono::high_resolution_clock::now();
+    shared.nodeLimit = limits.nodes;
+    if (limits.nodes != 0)
+        rng.seed(0);//Fixed node searches are used for reproducible tests, the move shuffling must not change the result
+
+    const size_t maxDepth = limits.maxDepth;
+
+    auto boardList = generateMoves(board,board.playerOnMove, playedPositions);
+
+    const float gamePhase = (17.0f - board.countPiecesMin()) / 16.0f;
+
+    if (traceRecorder)
+    {
+        traceRecorder->gamePhase = gamePhase;
+        traceRecorder->threads = options.Threads;
+    }
+
+    TimeManager tm = [&]() {
+        if (limits.moveTime != duration_t(0))
+            return TimeManager::fromMoveTime(limits.moveTime, options.Threads);
+
+        //We have to calculate our own time
+        const auto& myTime = limits.playerTime[index(board.playerOnMove)];// == PlayerSide::WHITE ? wtime : btime;
+        const auto& myInc = limits.playerInc[index(board.playerOnMove)];// == PlayerSide::WHITE ? winc : binc;
+
+        return TimeManager::fromClock(myTime, myInc, gamePhase, options.Threads);
+    }();
+
+    //When pondering, our clock is not running yet. The search deepens without limits and the budget starts counting from ponderhit.
+    auto timeOrigin = [&]() {
+        return limits.ponder ? shared.ponderhitTime.load() : timeGlobalStarted;
+    };
+    auto elapsed = [&]() {
+        if (shared.pondering)
+            return duration_t(0);
+        return duration_t(std::chrono::high_resolution_clock::now() - timeOrigin());
+    };
+    auto remainingMax = [&]() {
+        return tm.hardLimit() - elapsed();
+    };
+    //The hard deadline runs from the moment go is received. The soft one only ends the search after the broad depths, which have to finish.
+    bool softDeadlineArmed = false;
+    searchTimer.arm(timeGlobalStarted, duration_t(std::numeric_limits<double>::infinity()), tm.criticalLimit(), limits.ponder);
+
+    //Runs one iteration over the remaining root moves and lets the time manager know how it went
+    SEARCH_STAT(size_t lastIterationNodes = 0; i8 lastIterationDepth = 0;)
+    auto searchIteration = [&](i8 depth) {
+        auto started = std::chrono::high_resolution_clock::now();
+        SEARCH_STAT(const auto statsBefore = searchStatsTotal(); const size_t nodesBefore = searchedNodes();)
+        findBestOnSameLevel(boardList, depth);
+#ifdef SEARCH_STATS
+        {
+            const auto stats = searchStatsTotal();
+            const size_t nodes = searchedNodes() - nodesBefore;
+            const size_t interior = stats.interiorNodes - statsBefore.interiorNodes;
+            const size_t cutoffs = stats.cutoffs - statsBefore.cutoffs;
+            const size_t firstMoveCutoffs = stats.firstMoveCutoffs - statsBefore.firstMoveCutoffs;
+            if (options.Verbosity >= 2)
+            {
+                std::osyncstream(out) << "info string stats depth " << (unsigned)depth
+                    << " nodes " << nodes
+                    << " interior " << interior
+                    << " cutoffs " << cutoffs
+                    << std::fixed << std::setprecision(1)
+                    << " cutoffrate " << (interior ? 100.0 * cutoffs / interior : 0) << '%'
+                    << " firstmove " << (cutoffs ? 100.0 * firstMoveCutoffs / cutoffs : 0) << '%'
+                    << std::setprecision(2)
+                    << " ebf " << (lastIterationNodes ? std::pow(double(nodes) / lastIterationNodes, 1.0 / (depth - lastIterationDepth)) : 0)//Per ply, the iterations may deepen by more
+                    << " seldepth " << stats.seldepth
+                    << nl << std::flush;
+            }
+            lastIterationNodes = nodes;
+            lastIterationDepth = depth;
+        }
+#endif
+
+        IterationSample sample;
+        sample.depth = depth;
+        sample.iterationTime = std::chrono::high_resolution_clock::now() - started;
+        sample.elapsed = elapsed();
+        sample.bestMove = boardList.front().firstMoveNotation;
+        sample.score = -boardList.front().bestFoundValue * boardList.front().firstMoveOnMove;
+        sample.bestMoveNodes = boardList.front().nodes;
+        for (const auto& i : boardList)
+            sample.totalNodes += i.nodes;
+        sample.rootMoves = boardList.size();
+        tm.update(sample);
+
+        if (traceRecorder)
+            traceRecorder->iterations.push_back(sample);
+        traceIteration(sample.iterationTime, sample.bestMove, depth, sample.totalNodes, sample.score, tm.softLimit(), tm.hardLimit());
+
+        //The soft deadline of the timer follows the rescaled limit
+        if (softDeadlineArmed)
+            searchTimer.setOptimal(tm.softLimit());
+    };
+
+
+    debugOut << "Targeting " << tm.softLimit().count() << " ms." << std::endl;
+    debugOut << "Highest I can go is " << tm.hardLimit().count() << " ms." << std::endl;
+
+
+
+    availableMoves = boardList.size();
+
+
+    moveNotation bestPosFound;
+    moveNotation ponderPosFound;
+
+    if (boardList.empty()) [[unlikely]]//Mate or stalemate, there is nothing to play
+    {
+        debugOut << "No legal move in this position" << std::endl;
+        bestPosFound = moveNotation("0000");
+    }
+    else if (boardList.size() == 1) [[unlikely]]//If there is only one possible move to be played, no need to think about anything
+    {
+        debugOut << "Only one move possible, no need to think about anything" << std::endl;
+        bestPosFound = std::move(boardList[0].firstMoveNotation);
+    }
+    else
+    {
+        size_t i = 4;
+
+        if (availableMoves > options.Threads) //Optimization for A/B pruning
+            firstLevelPruning = false; //Depth 4 no pruning
+
+        //Full depth search
+        {
+            for (; i <= 6; i += 2)
+            {
+                //Loking through everything in a specific depth, no cutoffs, trying to find even unlikely good moves
+
+                //fullDepth = i;
+                if (options.Verbosity >= 2)
+                    std::osyncstream(out) << "info depth " << i << nl << std::flush;
+
+                searchIteration(i);
+
+                bestPosFound = boardList.front().firstMoveNotation;
+                ponderPosFound = boardList.front().bestReplyNotation;
+
+                if (shared.criticalTimeDepleted) [[unlikely]]
+                {
+                    debugOut << "Search interrupted while in the broad depth mode" << std::endl;
+                    goto returnResult;
+                }
+
+                if (isMateScore(boardList.front().bestFoundValue))
+                {
+                    debugOut << "Mate possibility, no need to search further" << std::endl;
+                    goto returnResult;
+                }
+
+                if (remainingMax() <= duration_t(0))//Emergency stop if we depleted time
+                {
+                    debugOut << "Time ran out while in the broad depth mode" << std::endl;
+                    goto returnResult;
+                }
+
+
+                if (options.MultiPV == 1)
+                    firstLevelPruning = true;
+                else
+                    firstLevelPruning = false;
+            }
+        }
+
+        softDeadlineArmed = true;
+        searchTimer.setOptimal(tm.softLimit());
+
+        //Continuing full depth search while in the soft time window
+        {
+            for (; i <= maxDepth; i += 2)
+            {
+                if (!shared.pondering && !tm.shouldStart(elapsed(), boardList.size()))//While pondering, any extra depth is free
+                {
+                    debugOut << "It's time to end broad depth mode" << std::endl;
+                    break;
+                }
+                else
+                {
+                    debugOut << "There is plenty of time, continuing the broad depth mode" << std::endl;
+                }
+
+                //Loking through everything in a specific depth, no cutoffs, trying to find even unlikely good moves
+
+                //fullDepth = i;
+                if (options.Verbosity >= 2)
+                    std::osyncstream(out) << "info depth " << i << nl << std::flush;
+
+                searchIteration(i);
+
+                bestPosFound = boardList.front().firstMoveNotation;
+                ponderPosFound = boardList.front().bestReplyNotation;
+
+                if (shared.criticalTimeDepleted) [[unlikely]]
+                {
+                    debugOut << "Search interrupted while in the broad depth mode" << std::endl;
+                    goto returnResult;
+                }
+
+                if (isMateScore(boardList.front().bestFoundValue))
+                {
+                    debugOut << "Mate possibility, no need to search further" << std::endl;
+                    goto returnResult;
+                }
+
+                if (remainingMax() <= duration_t(0))//Emergency stop if we depleted time
+                {
+                    debugOut << "Time ran out while in the broad depth mode" << std::endl;
+                    goto returnResult;
+                }
+            }
+        }
+
+        debugOut << "Transitioning to selective depth mode" << std::endl;
+
+        //Seldepth search
+        {
+            Score centiPawnBreakingPoint = 512;
+            for (; i <= maxDepth; i += 2)
+            {
+                bool cutOff = cutoffBadMoves(boardList, centiPawnBreakingPoint);
+
+
+                if (boardList.size() == 1)
+                {
+                    debugOut << "Only one good move after cutoff, no need to search further" << std::endl;
+                    goto returnResult;
+                }
+
+                if (!shared.pondering && !tm.shouldStart(elapsed(), boardList.size()))//While pondering, any extra depth is free
+                {
+                    debugOut << "We wouldn't get a result in the time we want to spend on this move" << std::endl;
+                    goto returnResult;
+                }
+
+
+                if (options.Verbosity >= 2)
+                {
+                    i8 fullDepthInfo = fullDepth;
+                    if (boardList.size() == availableMoves)
+                        fullDepthInfo += 2;
+
+                    std::osyncstream o(out);
+                    o << "info depth " << (unsigned)fullDepthInfo;
+
+                    if (i != fullDepthInfo)
+                        o << " seldepth " << (unsigned)i;
+
+                    o << nl << std::flush;
+                }
+
+
+                searchIteration(i);
+
+                bestPosFound = boardList.front().firstMoveNotation;
+                ponderPosFound = boardList.front().bestReplyNotation;
+
+                if (shared.criticalTimeDepleted || remainingMax() <= duration_t(0))//Emergency stop if we depleted time or were told to stop
+                {
+                    debugOut << "Emergency stop!" << std::endl;
+                    goto returnResult;
+                }
+
+                if (isMateScore(boardList.front().bestFoundValue))
+                {
+                    debugOut << "Mate possibility, no need to search further" << std::endl;
+                    goto returnResult;
+                }
+
+                if (tm.stable() > 0)//Keep the wide margin while the best move keeps changing
+                    centiPawnBreakingPoint /= 2;
+            }
+        }
+    }
+
+
+    returnResult:
+    if (limits.mate > 0 && (boardList.empty() || !isMateScore(boardList.front().bestFoundValue)))
+        debugOut << "No mate in " << (int)limits.mate << " found" << std::endl;
+
+    //The GUI expects the result only after ponderhit (then the search continued as a timed one) or stop
+    shared.pondering.wait(true);
+    if (limits.infinite)
+        shared.criticalTimeDepleted.wait(false);
+
+    {
+        std::osyncstream o(out);
+        o << "bestmove " << bestPosFound;
+        if (!ponderPosFound.empty())
+            o << " ponder " << ponderPosFound;
+        o << nl << std::flush;
+    }
+
+    searchTimer.disarm();
+    traceFlush();
+
+#ifdef PROFILE_ZONES
+    printZoneProfile(debugOut);
+#endif
+}
+
+//The search runs on its own long-lived thread, so that the UCI loop keeps reading commands (stop, isready) while the engine is thinking
+std::thread searchThread;
+std::mutex searchM;
+std::condition_variable searchCv;
+std::function<void()> searchTask;
+bool searching = false;
+bool searchThreadEndWanted = false;
+
+void searchThreadLoop()
+{
+    ThreadPerfScope perf(0);
+    std::unique_lock l(searchM);
+    while (true)
+    {
+        searchCv.wait(l, [] { return searching || searchThreadEndWanted; });
+        if (!searching)
+            break;
+
+        auto task = std::move(searchTask);
+        l.unlock();
+        task();
+        l.lock();
+
+        searching = false;
+        searchCv.notify_all();
+    }
+}
+
+void waitForSearch()
+{
+    std::unique_lock l(searchM);
+    searchCv.wait(l, [] { return !searching; });
+}
+
+void startSearch(std::function<void()> task, bool ponder = false)
+{
+    std::unique_lock l(searchM);
+    searchCv.wait(l, [] { return !searching; });//Protocol says GUI should stop us first, but be tolerant and just queue behind
+
+    shared.criticalTimeDepleted = false;
+    shared.optimalTimeDepleted = false;
+    shared.pondering = ponder;//Set here, so that a ponderhit right after go cannot be missed
+
+    searchTask = std::move(task);
+    searching = true;
+    searchCv.notify_all();
+}
+
+void stopSearch()
+{
+    //Aborts all running computations on their next node, uciGo then reports the best move of the last finished depth
+    shared.criticalTimeDepleted = true;
+    shared.criticalTimeDepleted.notify_all();
+    shared.pondering = false;
+    shared.pondering.notify_all();
+    searchTimer.notify();
+}
+
+void ponderhit()
+{
+    //The opponent played the expected move. The running search continues as a timed one, keeping everything it found so far.
+    shared.ponderhitTime = std::chrono::high_resolution_clock::now();
+    shared.pondering = false;
+    shared.pondering.notify_all();
+    searchTimer.notify();
+}
+
+void searchThreadStart()
+{
+    searchThreadEndWanted = false;
+    searchThread = std::thread(searchThreadLoop);
+    searchTimer.start();
+}
+
+void searchThreadEnd()
+{
+    {
+        std::unique_lock l(searchM);
+        searchThreadEndWanted = true;
+    }
+    searchCv.notify_all();
+    searchThread.join();
+    searchTimer.end();
+}
+
+
+int uci(std::istream& in, std::ostream& output)
+{
+    outStream = &output;
+    //while (true)
+    //{
+        //std::string command;
+        //std::cin >> command;
+        //if (command == "isready")
+        //{
+        //    out << "readyok" << std::endl;
+    GameState board;
+    stack_vector<std::array<Piece, 64>, 75> playedPositions;
+    //std::ofstream debugOut("debug.log");
+
+    searchThreadStart();
+
+    while (true)
+    {
+        std::string command;
+        std::getline(in, command);
+        
+        if (!in.good()) [[unlikely]]
+        {
+            debugOut << "End of input stream, rude! End the uci session with 'quit' in a controlled way." << std::endl;
+            searchThreadEnd();//Nobody can tell us to stop anymore, let the running search finish on its own
+            threadRestart(0);
+            return 0;
+        }
+            
+        std::string_view commandView(command);
+        auto commandFirst = getWord(commandView);
+
+        if (commandFirst == "uci")
+        {
+            waitForSearch();
+            {
+                //board = GameState();
+#ifdef _DEBUG
+                options.MultiPV = 1;// maxMoves;
+                options.Threads = 1;
+                options.Verbosity = 7;
+#else
+                options.MultiPV = 1;
+                options.Threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+                options.Verbosity = 3;
+#endif
+                options.UCI_Chess960 = false;
+                options.Ponder = false;
+            }
+
+            if (threadWorkers.size() != options.Threads)
+                threadRestart(options.Threads);
+
+            out << "id name Klara Destroyer" << nl
+                << "id author Matej Kocourek" << nl
+                << "option name MultiPV type spin min 1 max 218 default " << options.MultiPV << nl
+                << "option name Threads type spin min 1 max 255 default " << options.Threads << nl
+                << "option name Verbosity type spin min 0 max 7 default " << options.Verbosity << nl
+                << "option name Ponder type check default false" << nl
+                << "option name TraceFile type string default <empty>" << nl
+                //<< "option name UCI_Chess960 type check default false" << nl
+                << "uciok" << nl
+                << std::flush;
+        }
+        else if (commandFirst == "ucinewgame")
+        {
+            waitForSearch();
+            board = GameState();
+        }
+        else if (commandFirst == "isready")
+        {
+            std::osyncstream(out) << "readyok" << nl << std::flush;//Answered right away, even while searching
+        }
+        else if (commandFirst == "stop")
+        {
+            stopSearch();
+        }
+        else if (commandFirst == "ponderhit")
+        {
+            ponderhit();
+        }
+        else if (commandFirst == "quit")
+        {
+            stopSearch();
+            searchThreadEnd();
+            threadRestart(0);
+            debugOut << "Bye!" << std::endl;
+            return 0;
+        }
+        else if (commandFirst == "position")
+        {
+            waitForSearch();
+            playedPositions.clear();
+            board = posFromString(commandView, playedPositions);
+        }
+        else if (commandFirst == "setoption")
+        {
+            waitForSearch();
+            if (getWord(commandView) != "name")
+                continue;
+            auto optionName = getWord(commandView);
+            if (getWord(commandView) != "value")
+                continue;
+            auto optionValue = getWord(commandView);
+            if (optionName == "MultiPV")
+            {
+                //debugOut << "Option value was: " << optionValue << std::endl;
+                options.MultiPV = std::atoll(optionValue.data());
+                debugOut << "Setting MultiPV to " << options.MultiPV << std::endl;
+            }
+            else if (optionName == "Threads")
+            {
+                //debugOut << "Option value was: " << optionValue << std::endl;
+                options.Threads = std::atoll(optionValue.data());
+                debugOut << "Setting Threads to " << options.Threads << std::endl;
+                if (threadWorkers.size() != options.Threads)
+                    threadRestart(options.Threads);
+            }
+            else if (optionName == "Verbosity")
+            {
+                //debugOut << "Option value was: " << optionValue << std::endl;
+                options.Verbosity = std::atoll(optionValue.data());
+                debugOut << "Setting Verbosity to " << options.Verbosity << std::endl;
+            }
+            else if (optionName == "UCI_Chess960")
+            {
+                options.UCI_Chess960 = (optionValue == "true");
+                debugOut << "Setting UCI_Chess960 to " << options.UCI_Chess960 << std::endl;
+            }
+            else if (optionName == "Ponder")
+            {
+                options.Ponder = (optionValue == "true");//Only tells us the GUI may send go ponder, nothing to set up
+                debugOut << "Setting Ponder to " << options.Ponder << std::endl;
+            }
+            else if (optionName == "TraceFile")
+            {
+                traceOpen(optionValue);
+                debugOut << "Setting TraceFile to " << optionValue << std::endl;
+            }
+            else
+            {
+                debugOut << "This option is not recognized. Skipping." << std::endl;
+            }
+        }
+        else if (commandFirst == "go" && commandView.starts_with("perft"))
+        {
+            getWord(commandView);
+            const auto depth = parseNumber(getWord(commandView));
+            if (!depth)
+                debugOut << "Perft depth is not a number, ignoring" << std::endl;
+            else
+                startSearch([=, depth = static_cast<i8>(std::clamp<long long>(*depth, 1, std::numeric_limits<i8>::max()))]() { perftDivide(board, depth, out); });
+        }
+        else if (commandFirst == "go")
+        {
+            SearchLimits limits;
+            bool timeGiven = false;
+            //int64_t wtime = 0, btime = 0, winc = 0, binc = 0;
+
+            while (true)
+            {
+                auto word = getWord(commandView);
+                if (word.empty())
+                    break;
+                else if (word == "wtime")
+                {
+                    limits.playerTime[index(PlayerSide::WHITE)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
+                    timeGiven = true;
+                }
+                else if (word == "btime")
+                {
+                    limits.playerTime[index(PlayerSide::BLACK)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
+                    timeGiven = true;
+                }
+                else if (word == "winc")
+                    limits.playerInc[index(PlayerSide::WHITE)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
+                else if (word == "binc")
+                    limits.playerInc[index(PlayerSide::BLACK)] = std::chrono::milliseconds(atoll(getWord(commandView).data()));
+                else if (word == "movetime")
+                {
+                    limits.moveTime = std::chrono::milliseconds(atoll(getWord(commandView).data()));
+                    timeGiven = true;
+                }
+                else if (word == "infinite")
+                {
+                    limits.infinite = true;
+                }
+                else if (word == "ponder")
+                {
+                    limits.ponder = true;
+                }
+                else if (word == "depth" || word == "nodes" || word == "mate")
+                {
+                    const auto value = parseNumber(getWord(commandView));
+                    if (!value)
+                        debugOut << "Value of " << word << " is not a number, ignoring" << std::endl;
+                    else if (word == "depth")//i8 plies, larger depths would wrap around
+                        limits.maxDepth = static_cast<i8>(std::clamp<long long>(*value, 1, std::numeric_limits<i8>::max()));
+                    else if (word == "nodes")
+                        limits.nodes = std::max(*value, 0ll);
+                    else
+                        limits.mate = static_cast<i8>(std::clamp(*value, 0ll, 60ll));
+                }
+            }
+
+            if (limits.mate > 0)//Mate in N moves needs 2N plies plus the king capture, the search deepens by 2
+                limits.maxDepth = std::min<i8>(limits.maxDepth, 2 * limits.mate + 2);
+
+            if (limits.infinite || !timeGiven)//E.g. "go depth 8" is not limited by time
+                limits.moveTime = duration_t(std::numeric_limits<double>::infinity());
+
+            startSearch([=]() mutable { uciGo(board, limits, playedPositions); }, limits.ponder);
+        }
+        else
+        {
+            debugOut << "Not recognized command, ignoring: " << commandFirst << std::endl;
+        }
+    }
+    //}
+//}
+}
+
+
+void benchmark(i8 depth, GameState board)
+{
+    board.print();
+    auto start = std::chrono::high_resolution_clock::now();
+    //doneMoves.clear();
+    //auto result = findBestOnTopLevel(researchedBoard,depth,onMove);
+    //auto result = findBestInTimeLimit(researchedBoard, onMove, timeToPlay);
+    auto result = findBestInNumberOfMoves(board, depth);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    //std::string_view move = result.firstMoveNotation.data();
+    //executeMove(board, move);
+    out << result.firstMoveNotation << std::endl;
+
+    out << "cp: " << result.bestFoundValue << std::endl;//<<"Total found score "<<result.second+result.first.balance()<<endl;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / 1000.0;
+    out << "Done in " << elapsed << "s." << std::endl;
+
+    //board.printW();
+}
+
+void writeTrace(std::ostream& o, const SearchTrace& trace)
+{
+    o << "trace " << trace.threads << ' ' << trace.gamePhase << ' ' << trace.fen << nl;
+    for (const auto& i : trace.iterations)
+    {
+        o << "it " << (int)i.depth << ' ' << i.elapsed.count() << ' ' << i.iterationTime.count() << ' ' << (i.bestMove.empty() ? moveNotation("-") : i.bestMove)
+            << ' ' << i.score << ' ' << i.bestMoveNodes << ' ' << i.totalNodes << ' ' << i.rootMoves << nl;
+    }
+    o << "end" << nl;
+}
+
+bool readTrace(std::istream& in, SearchTrace& trace)
+{
+    trace = SearchTrace();
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream ss(line);
+        std::string word;
+        ss >> word;
+        if (word == "trace")
+        {
+            ss >> trace.threads >> trace.gamePhase >> std::ws;
+            std::getline(ss, trace.fen);
+        }
+        else if (word == "it")
+        {
+            IterationSample sample;
+            int depth;
+            double elapsed, iterationTime;
+            std::string bestMove;
+            ss >> depth >> elapsed >> iterationTime >> bestMove >> sample.score >> sample.bestMoveNodes >> sample.totalNodes >> sample.rootMoves;
+            if (!ss)
+                throw std::exception("Malformed trace iteration");
+            sample.depth = depth;
+            sample.elapsed = duration_t(elapsed);
+            sample.iterationTime = duration_t(iterationTime);
+            if (bestMove != "-")
+                sample.bestMove = moveNotation(bestMove.c_str());
+            trace.iterations.push_back(sample);
+        }
+        else if (word == "end")
+            return true;
+    }
+    return false;
+}
+
+//Searches every position (one FEN per line) to a fixed depth without time limits and writes the iterations as traces
+void recordTraces(std::istream& positions, std::ostream& traces, i8 depth)
+{
+    std::string fen;
+    while (std::getline(positions, fen))
+    {
+        if (fen.empty() || fen[0] == '#')
+            continue;
+
+        SearchTrace trace;
+        trace.fen = fen;
+        traceRecorder = &trace;
+
+        std::stringstream script;
+        script << "uci\nsetoption name Verbosity value 0\nposition fen " << fen << "\ngo depth " << (int)depth << "\n";// No quit, end of input lets the search finish
+        std::stringstream ignored;
+        uci(script, ignored);
+
+        traceRecorder = nullptr;
+        writeTrace(traces, trace);
+        traces << std::flush;
+        debugOut << "Recorded " << trace.iterations.size() << " iterations of " << fen << std::endl;
+    }
+}
+
+//Replays the decisions uciGo would make with this clock against a recorded trace, treating the traces as consecutive moves of one game.
+//Only the full-width iterations are recorded, so the seldepth cutoffs are not simulated.
+void simulateTraces(std::istream& traces, duration_t time, duration_t inc, std::ostream& o)
+{
+    o << "Simulating " << time.count() << " ms + " << inc.count() << " ms" << nl;
+    o << std::setw(5) << "move" << std::setw(7) << "depth" << std::setw(12) << "used" << std::setw(12) << "soft" << std::setw(12) << "hard" << std::setw(12) << "clock" << "  status" << nl;
+
+    duration_t clock = time;
+    duration_t totalUsed(0);
+    duration_t minClock = time;
+    size_t moves = 0, depthSum = 0, aborted = 0, softCut = 0, truncated = 0;
+    bool flagged = false;
+
+    SearchTrace trace;
+    while (readTrace(traces, trace))
+    {
+        if (trace.iterations.empty())
+            continue;
+
+        TimeManager tm = TimeManager::fromClock(clock, inc, trace.gamePhase, trace.threads);
+        const duration_t critical = tm.criticalLimit();
+
+        duration_t used(0);
+        i8 depthReached = 0;
+        std::string_view status = "ok";
+
+        size_t k = 0;
+        for (; k < trace.iterations.size(); ++k)
+        {
+            const auto& sample = trace.iterations[k];
+
+            const bool softArmed = sample.depth > 6;//Depths 4 and 6 are always searched, the soft deadline is armed after them
+            if (softArmed && !tm.shouldStart(used, sample.rootMoves))
+                break;
+
+            if (sample.elapsed > critical && (!softArmed || critical <= tm.softLimit()))
+            {
+                used = critical;
+                status = "aborted";
+                ++aborted;
+                break;
+            }
+
+            if (softArmed && sample.elapsed > tm.softLimit())//The soft deadline stops handing out root moves, the iteration ends with the ones already running
+            {
+                used = std::max(used, tm.softLimit());
+                status = "soft cut";
+                ++softCut;
+                break;
+            }
+
+            tm.update(sample);
+            used = sample.elapsed;
+            depthReached = sample.depth;
+        }
+        if (k == trace.iterations.size() && tm.shouldStart(used, trace.iterations.back().rootMoves))
+        {
+            status = "trace too short";
+            ++truncated;
+        }
+
+        clock -= used;
+        if (clock < duration_t(0))
+        {
+            status = "FLAGGED";
+            flagged = true;
+        }
+        minClock = std::min(minClock, clock);
+        clock += inc;
+
+        totalUsed += used;
+        depthSum += depthReached;
+        ++moves;
+
+        o << std::setw(5) << moves << std::setw(7) << (int)depthReached << std::setw(12) << used.count() << std::setw(12) << tm.softLimit().count()
+            << std::setw(12) << tm.hardLimit().count() << std::setw(12) << clock.count() << "  " << status << nl;
+    }
+
+    if (moves == 0)
+    {
+        o << "No traces" << nl << std::flush;
+        return;
+    }
+
+    o << "moves " << moves << " time used " << totalUsed.count() << " ms, average " << (totalUsed / moves).count() << " ms, average depth " << 1.0 * depthSum / moves << nl;
+    o << "lowest clock " << minClock.count() << " ms, aborted by hard limit " << aborted << ", cut by soft limit " << softCut << ", trace too short " << truncated << ", " << (flagged ? "FLAGGED" : "no flag") << nl << std::flush;
+}
+
+}
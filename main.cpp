@@ -1,194 +1,721 @@
-#ifndef MS_STDLIB_BUGS // Allow overriding the autodetection.
-/* The Microsoft C and C++ runtime libraries that ship with Visual Studio, as
- * of 2017, have a bug that neither stdio, iostreams or wide iostreams can
- * handle Unicode input or output.  Windows needs some non-standard magic to
- * work around that.  This includes programs compiled with MinGW and Clang
- * for the win32 and win64 targets.
- */
-#  if ( _MSC_VER || __MINGW32__ || __MSVCRT__ )
- /* This code is being compiled either on MS Visual C++, or MinGW, or
-  * clang++ in compatibility mode for either, or is being linked to the
-  * msvcrt.dll runtime.
-  */
-#    define MS_STDLIB_BUGS 1
-#  else
-#    define MS_STDLIB_BUGS 0
-#  endif
-#endif
-
-#if MS_STDLIB_BUGS
-#  include <io.h>
-#  include <fcntl.h>
-#endif
-
-#include <fstream>
-#include <iostream>
-#include <queue>
-#include <sstream>
-#include <iomanip>
-
-
-
-#include "KlaraDestroyer.h"
-
-void init_locale(void)
-// Does magic so that wcout can work.
-{
-#if MS_STDLIB_BUGS
-    // Windows needs a little non-standard magic.
-    constexpr char cp_utf16le[] = ".1200"; // UTF-16 little-endian locale.
-    setlocale(LC_ALL, cp_utf16le);
-    _setmode(_fileno(stdout), _O_WTEXT);
-
-    /* Repeat for _fileno(stdin), if needed. */
-#else
-    // The correct locale name may vary by OS, e.g., "en_US.utf8".
-    constexpr char locale_name[] = "";
-    setlocale(LC_ALL, locale_name);
-    std::locale::global(std::locale(locale_name));
-    std::wcin.imbue(std::locale())
-        std::wcout.imbue(std::locale());
-
-#endif
-}
-
-
-auto benchmark(size_t depth)
-{
-    using namespace KlaraDestroyer;
-    std::stringstream ss;
-    ss << "uci\nsetoption name Verbosity value 1\nposition startpos\ngo infinite depth " << depth << "\nquit\n";
-    std::cerr << ss.str() << std::endl;
-    return uci(ss, std::cout);
-}
-
-int main(int argc, char** argv) {
-    using namespace KlaraDestroyer;
-    std::ios_base::sync_with_stdio(false);
-    //out.setf(std::ios::fixed, std::ios::floatfield);
-    //out.setf(std::ios::showpoint);
-    std::cerr.setf(std::ios::fixed, std::ios::floatfield);
-    std::cerr.setf(std::ios::showpoint);
-
-    //std::cerr.sync_with_stdio(false);
-    if (argc > 1)
-    {
-        //out.sync_with_stdio(false);
-        //out.precision(2);
-//#if out == std::wcout
-//        init_locale();
-//#endif
-
-        std::string_view argument(argv[1]);
-        if (argument == "bench")
-        {
-            shuffle = false;
-            if (argc < 3)
-                return 1;
-            int n = std::atoi(argv[2]);
-            benchmark(n);
-        }
-#ifdef _DEBUG
-        else if (argument == "test")
-        {
-            shuffle = false;
-            if (argc < 3)
-                return 1;
-            int n = std::atoi(argv[2]);
-
-            switch (n)
-            {
-            case(1):
-            {
-                GameState promotion;
-                promotion.pieceAt('h', '5') = Piece::PawnBlack;
-                promotion.pieceAt('d', '5') = Piece::PawnBlack;
-                promotion.pieceAt('f', '5') = Piece::KingBlack;
-                promotion.pieceAt('g', '1') = Piece::BishopBlack;
-                promotion.pieceAt('e', '2') = Piece::KingWhite;
-                promotion.pieceAt('b', '5') = Piece::PawnWhite;
-                promotion.pieceAt('a', '6') = Piece::PawnWhite;
-                promotion.playerOnMove = PlayerSide::WHITE;
-
-                promotion.print();
-
-                benchmark(8, promotion);
-            } break;
-            case (2):
-            {
-                GameState testMatu;
-                testMatu.pieceAt('h', '8') = Piece::KingBlack;
-                testMatu.pieceAt('a', '1') = Piece::KingWhite;
-                testMatu.pieceAt('g', '1') = Piece::RookWhite;
-                testMatu.pieceAt('a', '7') = Piece::RookWhite;
-                testMatu.pieceAt('b', '1') = Piece::QueenWhite;
-                testMatu.pieceAt('c', '7') = Piece::PawnWhite;
-                testMatu.playerOnMove = PlayerSide::WHITE;
-                testMatu.print();
-
-                benchmark(8, testMatu);
-            } break;
-            case (3):
-            {
-                GameState testMatu;
-                testMatu.pieceAt('h', '8') = Piece::KingBlack;
-                testMatu.pieceAt('h', '7') = Piece::PawnWhite;
-                testMatu.pieceAt('g', '6') = Piece::PawnWhite;
-                testMatu.pieceAt('h', '6') = Piece::KingWhite;
-                testMatu.pieceAt('h', '5') = Piece::PawnWhite;
-                testMatu.pieceAt('g', '5') = Piece::PawnWhite;
-
-                //testMatu.deleteAndOverwritePiece('h', '4', &kingWhite);
-                //testMatu.deleteAndOverwritePiece('h', '3', &pawnWhite);
-                //testMatu.deleteAndOverwritePiece('g', '3', &pawnWhite);
-                //testMatu.deleteAndOverwritePiece('g', '4', &pawnWhite);
-
-                testMatu.playerOnMove = PlayerSide::WHITE;
-                testMatu.print();
-
-                benchmark(8, testMatu);
-            } break;
-            case (4):
-            {
-                GameState test = GameState::startingPosition();
-                //constexpr auto tmp = test.piecesCount();
-
-                test.pieceAt('b', '1') = Piece::Nothing;
-                test.pieceAt('c', '1') = Piece::Nothing;
-                test.pieceAt('d', '1') = Piece::Nothing;
-                test.pieceAt('f', '1') = Piece::Nothing;
-                test.pieceAt('g', '1') = Piece::Nothing;
-
-                test.playerOnMove = PlayerSide::WHITE;
-                test.print();
-
-                benchmark(8, test);
-            } break;
-            case (5):
-            {
-                constexpr auto test = GameState::startingPosition();
-                auto balance = test.balance();//SEGFAULT!
-                constexpr auto counter = test.piecesCountA();
-                constexpr auto min = test.countPiecesMin();
-            } break;
-
-            default:
-                break;
-            }
-        }
-#endif
-        else
-        {
-            std::cerr << "Unknown argument" << std::endl;
-            return 1;
-        }
-    }
-    else
-    {
-        shuffle = true;
-        return uci(std::cin,std::cout);
-    }
-
-
-    return 0;
-}
+#ifndef MS_STDLIB_BUGS // Allow overriding the autodetection.
+/* The Microsoft C and C++ runtime libraries that ship with Visual Studio, as
+ * of 2017, have a bug that neither stdio, iostreams or wide iostreams can
+ * handle Unicode input or output.  Windows needs some non-standard magic to
+ * work around that.  This includes programs compiled with MinGW and Clang
+ * for the win32 and win64 targets.
+ */
+#  if ( _MSC_VER || __MINGW32__ || __MSVCRT__ )
+ /* This code is being compiled either on MS Visual C++, or MinGW, or
+  * clang++ in compatibility mode for either, or is being linked to the
+  * msvcrt.dll runtime.
+  */
+#    define MS_STDLIB_BUGS 1
+#  else
+#    define MS_STDLIB_BUGS 0
+#  endif
+#endif
+
+#if MS_STDLIB_BUGS
+#  include <io.h>
+#  include <fcntl.h>
+#endif
+
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <iomanip>
+#include <array>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+
+#include "KlaraDestroyer.h"
+
+void init_locale(void)
+// Does magic so that wcout can work.
+{
+#if MS_STDLIB_BUGS
+    // Windows needs a little non-standard magic.
+    constexpr char cp_utf16le[] = ".1200"; // UTF-16 little-endian locale.
+    setlocale(LC_ALL, cp_utf16le);
+    _setmode(_fileno(stdout), _O_WTEXT);
+
+    /* Repeat for _fileno(stdin), if needed. */
+#else
+    // The correct locale name may vary by OS, e.g., "en_US.utf8".
+    constexpr char locale_name[] = "";
+    setlocale(LC_ALL, locale_name);
+    std::locale::global(std::locale(locale_name));
+    std::wcin.imbue(std::locale())
+        std::wcout.imbue(std::locale());
+
+#endif
+}
+
+
+// Positions searched by the bench. Openings, middlegames, endgames, promotions, castling and mates,
+// the last ones are the positions from the debug tests.
+static constexpr std::array benchPositions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/2B1P3/5Q2/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "8/8/P7/1P1p1k1p/8/8/4K3/6b1 w - - 0 1",
+    "7k/R1P5/8/8/8/8/8/KQ4R1 w - - 0 1",
+    "7k/7P/6PK/6PP/8/8/8/8 w - - 0 1",
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/R3K2R w KQkq - 0 1",
+};
+
+// EPD lines carry only the first four FEN fields followed by operations
+std::string fenFromEpd(const std::string& line)
+{
+    std::istringstream ss(line.substr(0, line.find(';')));
+    std::string fields[6];
+    size_t count = 0;
+    while (count < 6 && ss >> fields[count])
+        ++count;
+    if (count < 4)
+        return "";
+
+    std::string fen = fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' + fields[3];
+    if (count == 6 && std::isdigit(fields[4][0]) && std::isdigit(fields[5][0]))
+        return fen + ' ' + fields[4] + ' ' + fields[5];
+    return fen + " 0 1";
+}
+
+// Built-in bench positions followed by the ones from the optional EPD file
+bool loadBenchPositions(const char* file, stack_vector<std::string, 1024>& fens)
+{
+    for (const auto& i : benchPositions)
+        fens.push_back(i);
+
+    if (file != nullptr)
+    {
+        std::ifstream epd(file);
+        if (!epd)
+        {
+            std::cerr << "Cannot open " << file << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(epd, line))
+        {
+            auto fen = fenFromEpd(line);
+            if (!fen.empty())
+                fens.push_back(std::move(fen));
+        }
+    }
+    return true;
+}
+
+// One line of hardware counters, counters that could not be opened are printed as n/a
+void printPerf(std::ostream& os, std::string_view label, const perf_counters::values& values)
+{
+    os << label;
+    for (size_t i = 0; i < perf_counters::count; ++i)
+    {
+        os << "  " << perf_counters::names[i] << ' ';
+        if (values.valid[i])
+            os << values.value[i];
+        else
+            os << "n/a";
+    }
+    os << "  IPC ";
+    if (values.ipc() != 0)
+        os << std::fixed << std::setprecision(2) << values.ipc();
+    else
+        os << "n/a";
+    os << nl;
+}
+
+// Counters of every thread that ran since the last reset, one line per thread if there were more of them, and their sum
+perf_counters::values printPerfThreads(std::ostream& os, size_t threads)
+{
+    using namespace KlaraDestroyer;
+
+    perf_counters::values total;
+    std::lock_guard l(perfTotalsM);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        if (threads > 1 && perfTotals[i].any_valid())
+            printPerf(os, "  thread " + std::to_string(i), perfTotals[i]);
+        total += perfTotals[i];
+    }
+    return total;
+}
+
+struct BenchResult
+{
+    std::string bestMove;
+    size_t nodes;
+    KlaraDestroyer::duration_t time;
+    KlaraDestroyer::duration_t barrierWait;
+};
+
+// One search to a fixed depth through the UCI loop
+BenchResult benchPosition(const std::string& fen, size_t depth, size_t threads)
+{
+    using namespace KlaraDestroyer;
+
+    std::stringstream ss;
+    ss << "uci\nsetoption name Threads value " << threads << "\nsetoption name Verbosity value 0\nposition fen " << fen << "\ngo depth " << depth << "\n"; // No quit, end of input lets the search finish
+    std::stringstream result;
+
+    resetPerfTotals();
+    auto start = std::chrono::steady_clock::now();
+    uci(ss, result);
+    duration_t elapsed = std::chrono::steady_clock::now() - start;
+
+    std::string bestMove;
+    for (std::string line; std::getline(result, line);)
+    {
+        if (line.starts_with("bestmove "))
+            bestMove = line.substr(9, line.find(' ', 9) - 9);
+    }
+
+    return { bestMove, searchedNodes(), elapsed, barrierWaitTotal() };
+}
+
+// Searches every bench position to a fixed depth and prints the nodes, time and speed.
+// The total node count is the signature of the build: with one thread it only changes when the search does.
+int benchmark(size_t depth, size_t threads, size_t hash, const char* file)
+{
+    using namespace KlaraDestroyer;
+
+    stack_vector<std::string, 1024> fens;
+    if (!loadBenchPositions(file, fens))
+        return 1;
+
+    if (hash != 0)
+        std::cerr << "There is no hash table, ignoring the hash size" << std::endl;
+
+    size_t totalNodes = 0;
+    duration_t totalTime(0);
+    perf_counters::values totalPerf;
+    SEARCH_STAT(SearchStats totalStats{};)
+
+    for (size_t i = 0; i < fens.size(); ++i)
+    {
+        const auto res = benchPosition(fens[i], depth, threads);
+        totalNodes += res.nodes;
+        totalTime += res.time;
+        SEARCH_STAT(totalStats += searchStatsTotal();)
+
+        std::cout << "Position " << std::setw(3) << (i + 1) << '/' << fens.size() << ' ' << std::setw(6) << res.bestMove
+            << std::setw(12) << res.nodes << " nodes " << std::setw(10) << std::fixed << std::setprecision(1) << res.time.count() << " ms  " << fens[i] << std::endl;
+
+        if (perfCountersEnabled)
+        {
+            auto perf = printPerfThreads(std::cout, threads);
+            if (perf.any_valid())
+                printPerf(std::cout, "  counters", perf);
+            totalPerf += perf;
+        }
+    }
+
+    std::cout << "===========================" << nl
+        << "Total time (ms) : " << (size_t)round(totalTime.count()) << nl
+        << "Nodes searched  : " << totalNodes << nl
+        << "Nodes/second    : " << (size_t)round(totalNodes / (totalTime.count() / 1000)) << nl;
+#ifdef SEARCH_STATS
+    std::cout << "Interior nodes  : " << totalStats.interiorNodes << nl
+        << "Cutoffs         : " << totalStats.cutoffs << std::fixed << std::setprecision(1)
+        << " (" << (totalStats.interiorNodes ? 100.0 * totalStats.cutoffs / totalStats.interiorNodes : 0) << "% of interior nodes)" << nl
+        << "First move cuts : " << (totalStats.cutoffs ? 100.0 * totalStats.firstMoveCutoffs / totalStats.cutoffs : 0) << '%' << nl
+        << "Max seldepth    : " << totalStats.seldepth << nl;
+#endif
+    if (perfCountersEnabled)
+    {
+        if (totalPerf.any_valid())
+        {
+            printPerf(std::cout, "Counters        :", totalPerf);
+            if (totalPerf.valid[perf_counters::instructions] && totalNodes != 0)
+                std::cout << "Instructions/node: " << std::fixed << std::setprecision(1) << double(totalPerf.value[perf_counters::instructions]) / totalNodes << nl;
+        }
+        else
+            std::cout << "No hardware counters available (perf_event_open failed, see /proc/sys/kernel/perf_event_paranoid)" << nl;
+    }
+    if (threads != 1)
+        std::cout << "The node count is only reproducible with 1 thread" << nl;
+    std::cout << std::flush;
+    return 0;
+}
+
+// Searches the bench positions with 1, 2, 4, ... threads and compares the time to reach the depth.
+// Idle is the share of the thread time spent at the barrier, waiting for the slowest root move of the iteration.
+int scaling(size_t depth, size_t maxThreads, const char* file)
+{
+    using namespace KlaraDestroyer;
+
+    stack_vector<std::string, 1024> fens;
+    if (!loadBenchPositions(file, fens))
+        return 1;
+
+    stack_vector<size_t, 32> threadCounts;
+    for (size_t i = 1; i < maxThreads; i *= 2)
+        threadCounts.push_back(i);
+    threadCounts.push_back(maxThreads);
+
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "time (ms)" << std::setw(14) << "nodes" << std::setw(12) << "nps"
+        << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << std::setw(10) << "idle" << std::endl;
+
+    duration_t baseTime(0);
+    for (size_t threads : threadCounts)
+    {
+        size_t totalNodes = 0;
+        duration_t totalTime(0);
+        duration_t totalWait(0);
+        for (const auto& fen : fens)
+        {
+            const auto res = benchPosition(fen, depth, threads);
+            totalNodes += res.nodes;
+            totalTime += res.time;
+            totalWait += res.barrierWait;
+        }
+        if (threads == 1)
+            baseTime = totalTime;
+
+        const double speedup = baseTime / totalTime;
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1)
+            << std::setw(14) << totalTime.count()
+            << std::setw(14) << totalNodes
+            << std::setw(12) << (size_t)round(totalNodes / (totalTime.count() / 1000))
+            << std::setprecision(2)
+            << std::setw(10) << speedup
+            << std::setw(11) << 100 * speedup / threads << '%'
+            << std::setw(9) << 100 * (totalWait / (totalTime * threads)) << '%' << std::endl;
+    }
+    return 0;
+}
+
+// Feeds the UCI loop one line at a time and blocks when there is nothing to read, like the pipe from a GUI
+class LineFeedBuf : public std::streambuf
+{
+    std::mutex m;
+    std::condition_variable cv;
+    std::queue<std::string> lines;
+    std::string current;
+    bool closed = false;
+
+protected:
+    int_type underflow() override
+    {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        std::unique_lock l(m);
+        cv.wait(l, [&] { return !lines.empty() || closed; });
+        if (lines.empty())
+            return traits_type::eof();
+        current = std::move(lines.front());
+        lines.pop();
+        setg(current.data(), current.data(), current.data() + current.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+public:
+    void push(std::string line)
+    {
+        {
+            std::unique_lock l(m);
+            lines.push(std::move(line) + '\n');
+        }
+        cv.notify_one();
+    }
+};
+
+// Swallows the engine output and timestamps every bestmove line as it is written
+class BestmoveWatchBuf : public std::streambuf
+{
+    std::mutex m;
+    std::condition_variable cv;
+    std::string line;
+    size_t bestmoves = 0;
+    std::chrono::steady_clock::time_point lastBestmove;
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+
+        if (c == '\n')
+        {
+            if (line.starts_with("bestmove"))
+            {
+                auto now = std::chrono::steady_clock::now();
+                {
+                    std::unique_lock l(m);
+                    lastBestmove = now;
+                    ++bestmoves;
+                }
+                cv.notify_all();
+            }
+            line.clear();
+        }
+        else
+            line.push_back(traits_type::to_char_type(c));
+        return c;
+    }
+
+public:
+    std::chrono::steady_clock::time_point waitForBestmove(size_t count)
+    {
+        std::unique_lock l(m);
+        cv.wait(l, [&] { return bestmoves >= count; });
+        return lastBestmove;
+    }
+};
+
+// Replays position + go movetime pairs through the UCI loop and measures how late the bestmove arrives after the go was sent
+int latency(size_t samples, const stack_vector<size_t, 32>& moveTimes)
+{
+    using namespace KlaraDestroyer;
+
+    LineFeedBuf inBuf;
+    BestmoveWatchBuf outBuf;
+    std::istream in(&inBuf);
+    std::ostream output(&outBuf);
+
+    std::thread engine([&] { uci(in, output); });
+    inBuf.push("uci");
+
+    size_t bestmoves = 0;
+    stack_vector<double, 10000> fixedOverhead;
+
+    std::cout << std::setw(10) << "movetime" << std::setw(9) << "samples" << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p95"
+        << std::setw(10) << "p99" << std::setw(10) << "max" << "  (overshoot over movetime, ms)" << std::endl;
+
+    for (size_t moveTime : moveTimes)
+    {
+        stack_vector<double, 10000> overshoot;
+        for (size_t i = 0; i < samples; ++i)
+        {
+            inBuf.push(std::string("position fen ") + benchPositions[i % benchPositions.size()]);
+            const auto sent = std::chrono::steady_clock::now();
+            inBuf.push("go movetime " + std::to_string(moveTime));
+            const auto received = outBuf.waitForBestmove(++bestmoves);
+
+            const double late = duration_t(received - sent).count() - moveTime;
+            overshoot.push_back(late);
+            if (moveTime <= 1)
+                fixedOverhead.push_back(late + moveTime);
+        }
+
+        std::sort(overshoot.begin(), overshoot.end());
+        auto percentile = [&](double p) { return overshoot[std::min(overshoot.size() - 1, (size_t)ceil(p * overshoot.size()) - 1)]; };
+        double mean = 0;
+        for (auto i : overshoot)
+            mean += i;
+        mean /= overshoot.size();
+
+        std::cout << std::setw(10) << moveTime << std::setw(9) << overshoot.size() << std::fixed << std::setprecision(2)
+            << std::setw(10) << mean << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.95)
+            << std::setw(10) << percentile(0.99) << std::setw(10) << overshoot.back() << std::endl;
+    }
+
+    if (!fixedOverhead.empty())
+    {
+        std::sort(fixedOverhead.begin(), fixedOverhead.end());
+        std::cout << "Fixed overhead at movetime 0-1: p50 " << fixedOverhead[fixedOverhead.size() / 2]
+            << " ms, max " << fixedOverhead.back() << " ms over " << fixedOverhead.size() << " searches" << std::endl;
+    }
+
+    inBuf.push("quit");
+    engine.join();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    using namespace KlaraDestroyer;
+    std::ios_base::sync_with_stdio(false);
+    //out.setf(std::ios::fixed, std::ios::floatfield);
+    //out.setf(std::ios::showpoint);
+    std::cerr.setf(std::ios::fixed, std::ios::floatfield);
+    std::cerr.setf(std::ios::showpoint);
+
+    //std::cerr.sync_with_stdio(false);
+
+    //--perf anywhere on the command line reads the hardware counters in bench and perft
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--perf")
+        {
+            perfCountersEnabled = true;
+            std::copy(argv + i + 1, argv + argc, argv + i);
+            --argc;
+            break;
+        }
+    }
+
+    if (argc > 1)
+    {
+        //out.sync_with_stdio(false);
+        //out.precision(2);
+//#if out == std::wcout
+//        init_locale();
+//#endif
+
+        std::string_view argument(argv[1]);
+        if (argument == "bench")
+        {
+            //bench [depth] [threads] [hash] [file]
+            shuffle = false;
+            size_t depth = argc > 2 ? std::atoi(argv[2]) : 6;
+            size_t threads = argc > 3 ? std::atoi(argv[3]) : 1;
+            size_t hash = argc > 4 ? std::atoi(argv[4]) : 0;
+            const char* file = argc > 5 ? argv[5] : nullptr;
+            return benchmark(depth, threads, hash, file);
+        }
+        else if (argument == "scaling")
+        {
+            //scaling [depth] [max threads] [file]
+            shuffle = false;
+            size_t depth = argc > 2 ? std::atoi(argv[2]) : 6;
+            size_t threadLimit = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+            const char* file = argc > 4 ? argv[4] : nullptr;
+            return scaling(depth, std::clamp<size_t>(threadLimit, 1, maxThreads), file);
+        }
+        else if (argument == "latency")
+        {
+            //latency [samples] [movetime ms ...]
+            size_t samples = argc > 2 ? std::clamp(std::atoi(argv[2]), 1, 10000) : 200;
+            stack_vector<size_t, 32> moveTimes;
+            for (int i = 3; i < argc && moveTimes.size() < moveTimes.capacity(); ++i)
+                moveTimes.push_back(std::atoi(argv[i]));
+            if (moveTimes.empty())
+                moveTimes = { 0, 1, 5, 10, 50 };
+            return latency(samples, moveTimes);
+        }
+        else if (argument == "perft")
+        {
+            //perft <depth> [threads] [hash MB] [fen]
+            if (argc < 3)
+            {
+                std::cerr << "Usage: perft <depth> [threads] [hash MB] [fen]" << std::endl;
+                return 1;
+            }
+            const i8 depth = std::atoi(argv[2]);
+            const size_t threads = argc > 3 ? std::atoi(argv[3]) : 1;
+            const size_t hash = argc > 4 ? std::atoi(argv[4]) : 0;
+            std::string fen;
+            for (int i = 5; i < argc; ++i)
+                fen.append(argv[i]).append(" ");
+
+            GameState board = GameState::startingPosition();
+            if (!fen.empty())
+            {
+                std::string_view fenView(fen);
+                board = posFromFen(fenView);
+            }
+
+            resetPerfTotals();
+            {
+                ThreadPerfScope perf(0);//The main thread is the first one of the pool here
+                threadRestart(threads);
+                perftTableResize(hash);
+                perftDivide(board, depth, std::cout);
+                threadRestart(0);
+            }
+            if (perfCountersEnabled)
+            {
+                auto perf = printPerfThreads(std::cout, threads);
+                if (perf.any_valid())
+                    printPerf(std::cout, "Counters:", perf);
+                else
+                    std::cout << "No hardware counters available (perf_event_open failed, see /proc/sys/kernel/perf_event_paranoid)" << nl;
+            }
+        }
+        else if (argument == "trace")
+        {
+            //trace record <depth> <positions file> <trace file>
+            //trace simulate <trace file> <time ms> <inc ms> [<time ms> <inc ms> ...]
+            shuffle = false;
+            auto usage = []() {
+                std::cerr << "Usage: trace record <depth> <positions file> <trace file>" << std::endl;
+                std::cerr << "       trace simulate <trace file> <time ms> <inc ms> [<time ms> <inc ms> ...]" << std::endl;
+                return 1;
+                };
+            if (argc < 4)
+                return usage();
+            std::string_view mode(argv[2]);
+            if (mode == "record" && argc >= 6)
+            {
+                std::ifstream positions(argv[4]);
+                std::ofstream traces(argv[5]);
+                if (!positions || !traces)
+                {
+                    std::cerr << "Cannot open the files" << std::endl;
+                    return 1;
+                }
+                recordTraces(positions, traces, std::atoi(argv[3]));
+            }
+            else if (mode == "simulate" && argc >= 6 && argc % 2 == 0)
+            {
+                for (int i = 4; i < argc; i += 2)
+                {
+                    std::ifstream traces(argv[3]);
+                    if (!traces)
+                    {
+                        std::cerr << "Cannot open the trace file" << std::endl;
+                        return 1;
+                    }
+                    simulateTraces(traces, std::chrono::milliseconds(std::atoll(argv[i])), std::chrono::milliseconds(std::atoll(argv[i + 1])), std::cout);
+                }
+            }
+            else
+                return usage();
+        }
+#ifdef _DEBUG
+        else if (argument == "test")
+        {
+            shuffle = false;
+            if (argc < 3)
+                return 1;
+            int n = std::atoi(argv[2]);
+
+            switch (n)
+            {
+            case(1):
+            {
+                GameState promotion;
+                promotion.setPieceAt('h', '5', Piece::PawnBlack);
+                promotion.setPieceAt('d', '5', Piece::PawnBlack);
+                promotion.setPieceAt('f', '5', Piece::KingBlack);
+                promotion.setPieceAt('g', '1', Piece::BishopBlack);
+                promotion.setPieceAt('e', '2', Piece::KingWhite);
+                promotion.setPieceAt('b', '5', Piece::PawnWhite);
+                promotion.setPieceAt('a', '6', Piece::PawnWhite);
+                promotion.playerOnMove = PlayerSide::WHITE;
+
+                promotion.print();
+
+                benchmark(8, promotion);
+            } break;
+            case (2):
+            {
+                GameState testMatu;
+                testMatu.setPieceAt('h', '8', Piece::KingBlack);
+                testMatu.setPieceAt('a', '1', Piece::KingWhite);
+                testMatu.setPieceAt('g', '1', Piece::RookWhite);
+                testMatu.setPieceAt('a', '7', Piece::RookWhite);
+                testMatu.setPieceAt('b', '1', Piece::QueenWhite);
+                testMatu.setPieceAt('c', '7', Piece::PawnWhite);
+                testMatu.playerOnMove = PlayerSide::WHITE;
+                testMatu.print();
+
+                benchmark(8, testMatu);
+            } break;
+            case (3):
+            {
+                GameState testMatu;
+                testMatu.setPieceAt('h', '8', Piece::KingBlack);
+                testMatu.setPieceAt('h', '7', Piece::PawnWhite);
+                testMatu.setPieceAt('g', '6', Piece::PawnWhite);
+                testMatu.setPieceAt('h', '6', Piece::KingWhite);
+                testMatu.setPieceAt('h', '5', Piece::PawnWhite);
+                testMatu.setPieceAt('g', '5', Piece::PawnWhite);
+
+                //testMatu.deleteAndOverwritePiece('h', '4', &kingWhite);
+                //testMatu.deleteAndOverwritePiece('h', '3', &pawnWhite);
+                //testMatu.deleteAndOverwritePiece('g', '3', &pawnWhite);
+                //testMatu.deleteAndOverwritePiece('g', '4', &pawnWhite);
+
+                testMatu.playerOnMove = PlayerSide::WHITE;
+                testMatu.print();
+
+                benchmark(8, testMatu);
+            } break;
+            case (4):
+            {
+                GameState test = GameState::startingPosition();
+                //constexpr auto tmp = test.piecesCount();
+
+                test.setPieceAt('b', '1', Piece::Nothing);
+                test.setPieceAt('c', '1', Piece::Nothing);
+                test.setPieceAt('d', '1', Piece::Nothing);
+                test.setPieceAt('f', '1', Piece::Nothing);
+                test.setPieceAt('g', '1', Piece::Nothing);
+
+                test.playerOnMove = PlayerSide::WHITE;
+                test.print();
+
+                benchmark(8, test);
+            } break;
+            case (5):
+            {
+                constexpr auto test = GameState::startingPosition();
+                auto balance = test.balance();//SEGFAULT!
+                constexpr auto counter = test.piecesCountA();
+                constexpr auto min = test.countPiecesMin();
+            } break;
+
+            default:
+                break;
+            }
+        }
+#endif
+        else
+        {
+            std::cerr << "Unknown argument" << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        shuffle = true;
+        return uci(std::cin,std::cout);
+    }
+
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+// Microbenchmarks of the engine kernels. Every kernel is timed in repeated samples and reported in ns per operation,
+// so that low-level changes can be judged on numbers. Usage: KlaraDestroyerMicrobench [name filter]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "KlaraDestroyer.h"
+
+using namespace KlaraDestroyer;
+
+// Keeps the compiler from optimizing away a result nobody reads
+template <typename T>
+void doNotOptimize(const T& value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    static const void* volatile sink;
+    sink = &value;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+static constexpr size_t samples = 21;
+static constexpr duration_t minSampleTime = duration_t(5);
+static std::string_view filter;
+
+// Runs the kernel in samples long enough to be measured reliably and prints ns/op statistics
+template <typename F>
+void bench(std::string_view name, F&& kernel)
+{
+    if (!filter.empty() && name.find(filter) == std::string_view::npos)
+        return;
+
+    auto runBatch = [&](size_t iterations) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            kernel(i);
+        return duration_t(std::chrono::steady_clock::now() - start);
+    };
+
+    //Calibrate the batch size, this also warms up the caches
+    size_t iterations = 1;
+    while (runBatch(iterations) < minSampleTime)
+        iterations *= 2;
+
+    std::array<double, samples> nsPerOp;
+    for (auto& i : nsPerOp)
+        i = runBatch(iterations).count() * 1000000.0 / iterations;
+
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+    double mean = 0;
+    for (auto i : nsPerOp)
+        mean += i;
+    mean /= samples;
+    double variance = 0;
+    for (auto i : nsPerOp)
+        variance += (i - mean) * (i - mean);
+    const double stddev = std::sqrt(variance / (samples - 1));
+
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(2)
+        << std::setw(12) << nsPerOp[samples / 2]
+        << std::setw(12) << mean
+        << std::setw(10) << stddev
+        << std::setw(12) << nsPerOp.front()
+        << std::setw(12) << nsPerOp.back()
+        << std::setw(12) << iterations << std::endl;
+}
+
+static constexpr std::array fens = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+};
+
+GameState fromFen(const char* fen)
+{
+    std::string_view view(fen);
+    return posFromFen(view);
+}
+
+// First square holding the given piece, so that every position benchmarks the same kind of piece
+i8 findPiece(const GameState& board, Piece p)
+{
+    for (i8 i = 0; i < 64; ++i)
+        if (board.mailbox[boardSquares[i]] == p)
+            return i;
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    std::ios_base::sync_with_stdio(false);
+    std::cerr.setstate(std::ios::failbit);//The engine's debug output would only disturb the measurements
+    if (argc > 1)
+        filter = argv[1];
+
+    outStream = &std::cout;
+    shuffle = false;
+
+    std::array<GameState, fens.size()> positions;
+    for (size_t i = 0; i < fens.size(); ++i)
+        positions[i] = fromFen(fens[i]);
+    auto position = [&](size_t i) -> const GameState& { return positions[i % positions.size()]; };
+
+    std::cout << std::left << std::setw(28) << "kernel" << std::right
+        << std::setw(12) << "median ns" << std::setw(12) << "mean ns" << std::setw(10) << "stddev" << std::setw(12) << "min ns" << std::setw(12) << "max ns" << std::setw(12) << "ops/sample" << std::endl;
+
+    bench("GameState::balance", [&](size_t i) {
+        doNotOptimize(position(i).balance());
+        });
+
+    bench("priceInLocation", [&](size_t i) {
+        const auto& board = position(i / 64);
+        doNotOptimize(board.priceInLocation(boardSquares[i % 64], board.playerOnMove));
+        });
+
+    bench("calculatePhaseU8", [&](size_t i) {
+        doNotOptimize(calculatePhaseU8(position(i)));
+        });
+
+    {
+        //Positions after every first move of the starting position
+        const GameState start = GameState::startingPosition();
+        Variation<true> generator(start, 0, 1, start.playerOnMove, "");
+        firstPositions.clear();
+        generator.bestMoveScore(1, -scoreInfinite, scoreInfinite);
+        stack_vector<GameState, maxMoves> moved;
+        for (const auto& i : firstPositions)
+            moved.push_back(i.first);
+
+        bench("findDiff", [&](size_t i) {
+            doNotOptimize(moved[i % moved.size()].findDiff(start));
+            });
+    }
+
+    bench("posFromFen", [&](size_t i) {
+        doNotOptimize(fromFen(fens[i % fens.size()]));
+        });
+
+    bench("BoardHasher", [&](size_t i) {
+        doNotOptimize(BoardHasher()(position(i)));
+        });
+
+    {
+        stack_vector<Variation<>, maxMoves> variations;
+        for (size_t i = 0; i < 40; ++i)
+            variations.push_back(Variation<>(position(i), Score((i * 7919) % 101), 4, PlayerSide::BLACK, "e2e4"));
+
+        bench("stack_vector push 40", [&](size_t) {
+            stack_vector<Variation<>, maxMoves> res;
+            for (const auto& v : variations)
+                res.push_back(v);
+            doNotOptimize(res);
+            });
+
+        bench("stack_vector copy 40", [&](size_t) {
+            stack_vector<Variation<>, maxMoves> res(variations);
+            doNotOptimize(res);
+            });
+
+        bench("stack_vector sort 40", [&](size_t) {
+            stack_vector<Variation<>, maxMoves> res(variations);
+            std::sort(res.begin(), res.end(), std::greater<Variation<>>());
+            doNotOptimize(res);
+            });
+    }
+
+    //Move loop of a single piece, one ply deep (what canTakeKing runs for every piece)
+    constexpr std::array<std::pair<Piece, std::string_view>, 6> movingPieces = { {
+        { Piece::PawnWhite, "move loop pawn" },
+        { Piece::KnightWhite, "move loop knight" },
+        { Piece::BishopWhite, "move loop bishop" },
+        { Piece::RookWhite, "move loop rook" },
+        { Piece::QueenWhite, "move loop queen" },
+        { Piece::KingWhite, "move loop king" },
+    } };
+    for (const auto& [p, name] : movingPieces)
+    {
+        stack_vector<std::pair<Variation<>, i8>, fens.size()> pieces;
+        for (const auto& board : positions)
+        {
+            i8 square = findPiece(board, p);
+            if (square >= 0 && board.playerOnMove == PlayerSide::WHITE)
+                pieces.push_back({ Variation<>(board, 0, 1, board.playerOnMove, ""), square });
+        }
+        if (pieces.empty())
+            continue;
+
+        bench(name, [&](size_t i) {
+            auto& [variation, square] = pieces[i % pieces.size()];
+            Score alpha = -kingPrice, beta = kingPrice;
+            doNotOptimize(variation.bestMoveWithThisPieceScore(boardSquares[square], 0, alpha, beta));
+            });
+    }
+
+    {
+        stack_vector<Variation<>, fens.size()> variations;
+        for (const auto& board : positions)
+            variations.push_back(Variation<>(board, 0, 1, board.playerOnMove, ""));
+
+        bench("canTakeKing", [&](size_t i) {
+            auto& variation = variations[i % variations.size()];
+            doNotOptimize(variation.canTakeKing(variation.board.playerOnMove));
+            });
+    }
+
+    {
+        bench("generate moves", [&](size_t i) {
+            const auto& board = position(i);
+            Variation<true> generator(board, 0, 1, board.playerOnMove, "");
+            firstPositions.clear();
+            generator.bestMoveScore(1, -scoreInfinite, scoreInfinite);
+            doNotOptimize(firstPositions.size());
+            });
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// Hardware counters of the calling thread, read through perf_event_open.
+/// Every counter is opened on its own, so a counter the CPU, the kernel or the permissions do not allow is only marked unavailable.
+/// On other systems than Linux nothing is available.
+class perf_counters {
+public:
+	enum counter : size_t {
+		cycles,
+		instructions,
+		branch_misses,
+		l1d_misses,
+		llc_misses,
+		count
+	};
+
+	static constexpr std::array<std::string_view, count> names = { "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses" };
+
+	/// Counter values, a counter that could not be read is not valid
+	struct values {
+		std::array<uint64_t, count> value{};
+		std::array<bool, count> valid{};
+
+		values& operator+=(const values& other) {
+			for (size_t i = 0; i < count; ++i) {
+				value[i] += other.value[i];
+				valid[i] = valid[i] || other.valid[i];
+			}
+			return *this;
+		}
+
+		values operator-(const values& older) const {
+			values res;
+			for (size_t i = 0; i < count; ++i) {
+				res.valid[i] = valid[i] && older.valid[i];
+				res.value[i] = res.valid[i] ? value[i] - older.value[i] : 0;
+			}
+			return res;
+		}
+
+		bool any_valid() const {
+			for (bool i : valid)
+				if (i)
+					return true;
+			return false;
+		}
+
+		double ipc() const {
+			if (!valid[cycles] || !valid[instructions] || value[cycles] == 0)
+				return 0;
+			return double(value[instructions]) / value[cycles];
+		}
+	};
+
+	perf_counters() {
+		fds.fill(-1);
+	}
+	perf_counters(const perf_counters&) = delete;
+	perf_counters& operator=(const perf_counters&) = delete;
+	~perf_counters() {
+		close();
+	}
+
+	/// Starts counting on the calling thread, returns whether at least one counter is available
+	bool open() {
+		close();
+#ifdef __linux__
+		open_one(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		open_one(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		open_one(branch_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+		open_one(l1d_misses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+		open_one(llc_misses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+		for (int fd : fds)
+			if (fd != -1)
+				return true;
+		return false;
+	}
+
+	void close() {
+#ifdef __linux__
+		for (int& fd : fds) {
+			if (fd != -1)
+				::close(fd);
+			fd = -1;
+		}
+#endif
+	}
+
+	/// Current values, can be read from any thread
+	values read() const {
+		values res;
+#ifdef __linux__
+		for (size_t i = 0; i < count; ++i) {
+			uint64_t value;
+			if (fds[i] != -1 && ::read(fds[i], &value, sizeof(value)) == sizeof(value)) {
+				res.value[i] = value;
+				res.valid[i] = true;
+			}
+		}
+#endif
+		return res;
+	}
+
+private:
+	std::array<int, count> fds;
+
+#ifdef __linux__
+	void open_one(counter c, uint32_t type, uint64_t config) {
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.exclude_kernel = 1;// Allowed without privileges on most systems
+		attr.exclude_hv = 1;
+		fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		if (fds[c] < 0)
+			fds[c] = -1;
+	}
+#endif
+};